@@ -0,0 +1,75 @@
+/*
+ *  Copyright (C) 2016 the authors (see AUTHORS)
+ *
+ *  This file is part of ld36.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <algorithm>
+#include <cstring>
+
+#include "arena.h"
+
+
+Arena::Arena(std::size_t blockSize)
+	: _blockSize(blockSize)
+	, _offset(0)
+	, _used(0)
+	, _capacity(0)
+{
+}
+
+
+void* Arena::allocate(std::size_t size, std::size_t align) {
+	if(!_blocks.empty()) {
+		Block& block = _blocks.back();
+		std::size_t offset = (_offset + align - 1) & ~(align - 1);
+		if(offset + size <= block.size) {
+			_used  += offset + size - _offset;
+			_offset = offset + size;
+			return block.data.get() + offset;
+		}
+	}
+
+	addBlock(std::max(size + align, _blockSize));
+	return allocate(size, align);
+}
+
+
+const char* Arena::copyString(const std::string& str) {
+	char* dst = static_cast<char*>(allocate(str.size() + 1, 1));
+	std::memcpy(dst, str.c_str(), str.size() + 1);
+	return dst;
+}
+
+
+void Arena::clear() {
+	_blocks.clear();
+	_offset   = 0;
+	_used     = 0;
+	_capacity = 0;
+}
+
+
+void Arena::addBlock(std::size_t size) {
+	Block block;
+	block.data.reset(new Byte[size]);
+	block.size = size;
+	_blocks.push_back(std::move(block));
+	_offset    = 0;
+	_capacity += size;
+}
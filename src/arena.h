@@ -0,0 +1,75 @@
+/*
+ *  Copyright (C) 2016 the authors (see AUTHORS)
+ *
+ *  This file is part of ld36.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD36_ARENA_H
+#define LD36_ARENA_H
+
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <lair/core/lair.h>
+
+
+using namespace lair;
+
+
+// Monotonic allocator: memory is only given back all at once by clear().
+class Arena {
+public:
+	Arena(std::size_t blockSize = 4096);
+	Arena(const Arena&)  = delete;
+	Arena(      Arena&&) = default;
+	~Arena() = default;
+
+	Arena& operator=(const Arena&)  = delete;
+	Arena& operator=(      Arena&&) = default;
+
+	void* allocate(std::size_t size, std::size_t align = alignof(std::max_align_t));
+	const char* copyString(const std::string& str);
+
+	void clear();
+
+	std::size_t used()     const { return _used; }
+	std::size_t capacity() const { return _capacity; }
+
+protected:
+	typedef std::unique_ptr<Byte[]> BlockPtr;
+
+	struct Block {
+		BlockPtr    data;
+		std::size_t size;
+	};
+
+	void addBlock(std::size_t size);
+
+protected:
+	std::size_t        _blockSize;
+	std::vector<Block> _blocks;
+	std::size_t        _offset;
+	std::size_t        _used;
+	std::size_t        _capacity;
+};
+
+
+#endif
@@ -55,6 +55,7 @@ void setDoorOpen(MainState* state, EntityRef door, bool open) {
 		sc->setTileIndex(open? 0: 1);
 		cc->setEnabled(!open);
 		door.transform()(2, 3) = open? .2: .09;
+		state->setTransformDirty(door);
 	}
 	else {
 		dbgLogger.warning("setDoorOpen: ", door.name(), " do not look like a door.");
@@ -62,19 +63,34 @@ void setDoorOpen(MainState* state, EntityRef door, bool open) {
 }
 
 
+bool hasLevel(MainState* state, const char* cmd) {
+	if(!state->_level) {
+		dbgLogger.warning("Command ", cmd, ": No level is running.");
+		return false;
+	}
+	return true;
+}
+
+
 int switchDoorCommand(MainState* state, EntityRef self, int argc, const char** argv) {
 	if(argc != 2) {
 		dbgLogger.warning("Command ", argv[0], ": Invalid number of arguments.");
 		return -2;
 	}
 
-	state->playSound("door.wav");
+	if(!hasLevel(state, argv[0]))
+		return -2;
 
+	EntityRef source;
 	auto targets = state->_level->entities(argv[1]);
 	for(EntityRef entity: targets) {
 		setDoorOpen(state, entity, !isDoorOpen(state, entity));
+		if(!source.isValid())
+			source = entity;
 	}
 
+	state->playSound(state->_doorSound, source);
+
 	return 0;
 }
 
@@ -85,14 +101,20 @@ int setDoorCommand(MainState* state, EntityRef self, int argc, const char** argv
 		return -2;
 	}
 
-	state->playSound("door.wav");
+	if(!hasLevel(state, argv[0]))
+		return -2;
 
+	EntityRef source;
 	auto targets = state->_level->entities(argv[1]);
 	bool open = std::atoi(argv[2]);
 	for(EntityRef entity: targets) {
 		setDoorOpen(state, entity, open);
+		if(!source.isValid())
+			source = entity;
 	}
 
+	state->playSound(state->_doorSound, source);
+
 	return 0;
 }
 
@@ -113,7 +135,7 @@ int pickupItemCommand(MainState* state, EntityRef self, int argc, const char** a
 		return -2;
 	}
 
-	state->playSound("footstep.wav");
+	state->playSound(state->_footstepSound);
 	int item = sc->tileIndex();
 	state->addToInventory(Item(item));
 
@@ -161,6 +183,9 @@ int teleportCommand(MainState* state, EntityRef self, int argc, const char** arg
 		return -2;
 	}
 
+	if(!hasLevel(state, argv[0]))
+		return -2;
+
 	EntityRef target = state->_level->entity(argv[1]);
 	if(!target.isValid()) {
 		dbgLogger.warning("teleportCommand: target \"", target.name(), "\" not found.");
@@ -169,7 +194,7 @@ int teleportCommand(MainState* state, EntityRef self, int argc, const char** arg
 
 	float depth = state->_player.transform()(2, 3);
 	state->_player.place((Vector3() << target.translation2(), depth).finished());
-	state->playSound("tp.wav");
+	state->playSound(state->_tpSound);
 
 	TriggerComponent* tc = state->_triggers.get(target);
 	if(tc) {
@@ -189,7 +214,7 @@ int useObjectCommand(MainState* state, EntityRef self, int argc, const char** ar
 
 	Item item = Item(std::atoi(argv[1]));
 	if(state->hasItem(item)) {
-		state->playSound("footstep.wav");
+		state->playSound(state->_footstepSound);
 		state->removeFromInventory(item);
 		state->exec(argc - 2, argv + 2, self);
 	}
@@ -277,6 +302,9 @@ int bocalCommand(MainState* state, EntityRef self, int argc, const char** argv)
 		return -2;
 	}
 
+	if(!hasLevel(state, argv[0]))
+		return -2;
+
 	if(state->_endingState == END_BOCAL_OFF) {
 		state->_sprites.get(state->_level->entity("left"))->setTileIndex(1);
 		state->_sprites.get(state->_level->entity("right"))->setTileIndex(1);
@@ -293,8 +321,11 @@ int bocalKillCommand(MainState* state, EntityRef self, int argc, const char** ar
 		return -2;
 	}
 
+	if(!hasLevel(state, argv[0]))
+		return -2;
+
 	if(state->_endingState == END_BOCAL_ON) {
-		state->playSound("menu.wav");
+		state->playSound(state->_menuSound);
 		state->_sprites.get(state->_level->entity("bocal"))->setTileIndex(2);
 		state->popupMessage("lvl_f_bocal_kill");
 		state->_endingState = END_KILL;
@@ -309,9 +340,12 @@ int bocalSaveCommand(MainState* state, EntityRef self, int argc, const char** ar
 		return -2;
 	}
 
+	if(!hasLevel(state, argv[0]))
+		return -2;
+
 	if(state->_endingState == END_BOCAL_ON) {
 		if(state->hasItem(ITEM_ARTEFACT) && state->hasItem(ITEM_CHIP)) {
-			state->playSound("menu.wav");
+			state->playSound(state->_menuSound);
 			state->removeFromInventory(ITEM_ARTEFACT);
 			state->removeFromInventory(ITEM_CHIP);
 			state->_sprites.get(state->_level->entity("bocal"))->setTileIndex(1);
@@ -320,7 +354,7 @@ int bocalSaveCommand(MainState* state, EntityRef self, int argc, const char** ar
 			state->_endingState = END_SAVE;
 		}
 		else {
-			state->playSound("button.wav");
+			state->playSound(state->_buttonSound);
 			state->popupMessage("lvl_f_missing_items");
 		}
 	}
@@ -335,7 +369,7 @@ int letsFlyCommand(MainState* state, EntityRef self, int argc, const char** argv
 	}
 
 	if(state->hasItem(ITEM_MAN) && state->hasItem(ITEM_CABLE) && state->hasItem(ITEM_GROUP)) {
-		state->playSound("menu.wav");
+		state->playSound(state->_menuSound);
 		state->removeFromInventory(ITEM_MAN);
 		state->removeFromInventory(ITEM_CABLE);
 		state->removeFromInventory(ITEM_GROUP);
@@ -343,7 +377,7 @@ int letsFlyCommand(MainState* state, EntityRef self, int argc, const char** argv
 		state->setPostCommand("lets_fly_2");
 	}
 	else {
-		state->playSound("button.wav");
+		state->playSound(state->_buttonSound);
 		state->popupMessage("lvl_f_missing_items");
 	}
 
@@ -372,7 +406,7 @@ int letsQuitCommand(MainState* state, EntityRef self, int argc, const char** arg
 		return -2;
 	}
 
-	state->playSound("tp.wav");
+	state->playSound(state->_tpSound);
 
 	if(state->_endingState == END_SAVE)
 		state->popupMessage("lvl_f_swth_noship");
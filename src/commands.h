@@ -41,6 +41,7 @@ int echoCommand(MainState* state, EntityRef self, int argc, const char** argv);
 
 bool isDoorOpen(MainState* state, EntityRef door);
 void setDoorOpen(MainState* state, EntityRef door, bool open);
+bool hasLevel(MainState* state, const char* cmd);
 int switchDoorCommand(MainState* state, EntityRef self, int argc, const char** argv);
 int setDoorCommand(MainState* state, EntityRef self, int argc, const char** argv);
 
@@ -0,0 +1,67 @@
+/*
+ *  Copyright (C) 2016 the authors (see AUTHORS)
+ *
+ *  This file is part of ld36.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "message_table.h"
+
+
+// Compiles a message file (text.json) into the catalog mapped by the game
+// (text.bin). Run by the build, see src/CMakeLists.txt.
+int main(int argc, char** argv) {
+	if(argc != 3) {
+		std::cerr << "Usage: " << argv[0] << " SOURCE_JSON CATALOG\n";
+		return EXIT_FAILURE;
+	}
+
+	std::ifstream in(argv[1], std::ios::binary);
+	if(!in) {
+		std::cerr << argv[1] << ": failed to open.\n";
+		return EXIT_FAILURE;
+	}
+	std::string source((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	Json::Value  json;
+	Json::Reader reader;
+	if(!reader.parse(source, json)) {
+		std::cerr << argv[1] << ": " << reader.getFormattedErrorMessages();
+		return EXIT_FAILURE;
+	}
+	if(!json.isObject()) {
+		std::cerr << argv[1] << ": expected an object.\n";
+		return EXIT_FAILURE;
+	}
+
+	MessageTable messages;
+	messages.load(json, source);
+	if(!messages.writeCatalog(argv[2])) {
+		std::cerr << argv[2] << ": failed to write.\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,74 @@
+/*
+ *  Copyright (C) 2016 the authors (see AUTHORS)
+ *
+ *  This file is part of ld36.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <lair/core/log.h>
+
+#include "entity_pool.h"
+
+
+EntityPool::EntityPool(EntityManager* entities)
+	: _entities(entities)
+	, _name(nullptr)
+	, _nUsed(0)
+{
+}
+
+
+void EntityPool::setModel(EntityRef model, EntityRef parent, const char* name) {
+	lairAssert(_pool.empty());
+	_model  = model;
+	_parent = parent;
+	_name   = name;
+}
+
+
+void EntityPool::reserve(unsigned count) {
+	_pool.reserve(count);
+}
+
+
+EntityRef EntityPool::acquire() {
+	lairAssert(_model.isValid() && _parent.isValid());
+
+	if(_nUsed == _pool.size()) {
+		_pool.push_back(_entities->cloneEntity(_model, _parent, _name));
+	}
+
+	EntityRef entity = _pool[_nUsed];
+	++_nUsed;
+	entity.setEnabled(true);
+	return entity;
+}
+
+
+void EntityPool::releaseAll() {
+	for(unsigned i = 0; i < _nUsed; ++i)
+		_pool[i].setEnabled(false);
+	_nUsed = 0;
+}
+
+
+void EntityPool::clear() {
+	for(EntityRef& entity: _pool)
+		entity.release();
+	_pool.clear();
+	_nUsed = 0;
+}
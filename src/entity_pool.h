@@ -0,0 +1,76 @@
+/*
+ *  Copyright (C) 2016 the authors (see AUTHORS)
+ *
+ *  This file is part of ld36.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD36_ENTITY_POOL_H
+#define LD36_ENTITY_POOL_H
+
+
+#include <vector>
+
+#include <lair/core/lair.h>
+
+#include <lair/ec/entity.h>
+#include <lair/ec/entity_manager.h>
+
+
+using namespace lair;
+
+
+// Keeps clones of a model around instead of destroying them. releaseAll()
+// just disables the entities, which are handed back by acquire() before any
+// new clone is made. Resetting the components of acquired entities is up to
+// the caller.
+class EntityPool {
+public:
+	EntityPool(EntityManager* entities);
+	EntityPool(const EntityPool&)  = delete;
+	EntityPool(      EntityPool&&) = default;
+	~EntityPool() = default;
+
+	EntityPool& operator=(const EntityPool&)  = delete;
+	EntityPool& operator=(      EntityPool&&) = default;
+
+	void setModel(EntityRef model, EntityRef parent, const char* name = nullptr);
+	void reserve(unsigned count);
+
+	EntityRef acquire();
+	void releaseAll();
+
+	// Forget about all the entities. Use it when they are destroyed elsewhere.
+	void clear();
+
+	EntityRef model() const { return _model; }
+	unsigned  size()  const { return _pool.size(); }
+	unsigned  nUsed() const { return _nUsed; }
+
+protected:
+	EntityManager*         _entities;
+	EntityRef              _model;
+	EntityRef              _parent;
+	const char*            _name;
+
+	// The first _nUsed entities are in use, the others are free.
+	std::vector<EntityRef> _pool;
+	unsigned               _nUsed;
+};
+
+
+#endif
@@ -19,6 +19,8 @@
  */
 
 
+#include <cstring>
+
 #include "main_state.h"
 #include "splash_state.h"
 
@@ -34,10 +36,18 @@ Game::Game(int argc, char** argv)
     : GameBase(argc, argv),
       _mainState(),
       _splashState(),
-      _firstLevel("lvl_init.json") {
-
-	if(argc == 2) {
-		_firstLevel = argv[1];
+      _firstLevel("lvl_init.json"),
+      _lowPower(false),
+      _tickRate(TICKRATE),
+      _frameRate(FRAMERATE),
+      _loaded(false),
+      _loadStart(0) {
+
+	for(int i = 1; i < argc; ++i) {
+		if(std::strcmp(argv[i], "--low-power") == 0)
+			_lowPower = true;
+		else
+			_firstLevel = argv[i];
 	}
 }
 
@@ -46,6 +56,18 @@ Game::~Game() {
 }
 
 
+unsigned Game::readRate(const char* key, unsigned defaultRate) const {
+	const Json::Value& value = _config.get(key, defaultRate);
+	int rate = value.isNumeric()? value.asInt(): -1;
+	if(rate < MIN_RATE || rate > MAX_RATE) {
+		dbgLogger.warning("Invalid ", key, " in config (expected ", MIN_RATE, " to ",
+		                  MAX_RATE, "), using ", defaultRate, ".");
+		return defaultRate;
+	}
+	return rate;
+}
+
+
 void Game::initialize() {
 	GameBase::initialize();
 
@@ -54,19 +76,48 @@ void Game::initialize() {
 //	window()->setFullscreen(true);
 	sys()->setVSyncEnabled(_config.get("vsync", true).asBool());
 
+	_lowPower  = _lowPower || _config.get("low_power", false).asBool();
+	_tickRate  = readRate("tick_rate",  TICKRATE);
+	_frameRate = readRate("frame_rate", FRAMERATE);
+	if(_lowPower) {
+		_tickRate  = LOW_POWER_TICKRATE;
+		_frameRate = LOW_POWER_FRAMERATE;
+	}
+	dbgLogger.info("Tick rate: ", _tickRate, ", frame rate: ", _frameRate,
+	               _lowPower? " (low power)": "");
+
 	_splashState.reset(new SplashState(this));
 	_mainState.reset(new MainState(this));
 
 	_splashState->initialize();
 	_splashState->setup(_mainState.get(), "titlescreen.png", 3);
 
+	// Only the assets of the splash screen are waited for here. The rest is
+	// queued and finished by finishLoading() once the splash is on screen.
+	_loadStart = sys()->getTimeNs();
+	_music = _loader->loadAsset<MusicLoader>("pyramid.ogg");
 	_mainState->initialize();
+}
+
+
+bool Game::isLoaded() const {
+	return _loaded;
+}
+
+
+void Game::finishLoading() {
+	if(_loaded)
+		return;
+
+	_mainState->finishInitialize();
 	_mainState->startGame(_firstLevel);
 
-	AssetSP music = _loader->loadAsset<MusicLoader>("pyramid.ogg");
 	_loader->waitAll();
-	audio()->setMusicVolume(.075);
-	audio()->playMusic(music);
+	dbgLogger.info("Assets loaded in ", (sys()->getTimeNs() - _loadStart) / 1000000, " ms");
+	_mainState->playMusic(_music, .075);
+	_music.reset();
+
+	_loaded = true;
 }
 
 
@@ -95,3 +146,18 @@ SplashState* Game::splashState() {
 const Path& Game::firstLevel() {
 	return _firstLevel;
 }
+
+
+const Json::Value& Game::config() const {
+	return _config;
+}
+
+
+unsigned Game::tickRate() const {
+	return _tickRate;
+}
+
+
+unsigned Game::frameRate() const {
+	return _frameRate;
+}
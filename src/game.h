@@ -29,6 +29,10 @@
 using namespace lair;
 
 
+#define MIN_RATE 1
+#define MAX_RATE 1000
+
+
 class MainState;
 class SplashState;
 
@@ -46,16 +50,36 @@ public:
 	void initialize();
 	void shutdown();
 
+	// Main state initialization is completed while the splash is shown.
+	bool isLoaded() const;
+	void finishLoading();
+
 	MainState*   mainState();
 	SplashState* splashState();
 
 	const Path& firstLevel();
+	const Json::Value& config() const;
+
+	unsigned tickRate() const;
+	unsigned frameRate() const;
+
+protected:
+	// Reads a tick or frame rate from the config, falls back to defaultRate
+	// if it is missing or out of range.
+	unsigned readRate(const char* key, unsigned defaultRate) const;
 
 protected:
 	std::unique_ptr<SplashState> _splashState;
 	std::unique_ptr<MainState>   _mainState;
 
-	Path _firstLevel;
+	Path     _firstLevel;
+	bool     _lowPower;
+	unsigned _tickRate;
+	unsigned _frameRate;
+
+	bool    _loaded;
+	uint64  _loadStart;
+	AssetSP _music;
 };
 
 
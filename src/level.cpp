@@ -27,6 +27,11 @@
 #include "level.h"
 
 
+// Guessed cost of an entity with its components (not measured), used for
+// memory accounting.
+#define ENTITY_MEMORY_ESTIMATE 512
+
+
 bool isSolid(TileMap::TileIndex tile) {
 	unsigned x = (tile - 1) % TILE_SET_WIDTH;
 	return x >= TILE_SET_WIDTH / 2;
@@ -87,6 +92,10 @@ Box2 flipY(const Box2& box, float height) {
 Level::Level(MainState* mainState, const Path& path)
 	: _mainState(mainState)
 	, _path(path)
+	, _nextLayer(0)
+	, _nextObject(0)
+	, _ready(false)
+	, _lastUse(0)
 {
 }
 
@@ -97,6 +106,18 @@ void Level::preload() {
 
 
 void Level::initialize() {
+	if(isResident() && isReady()) {
+		reset();
+		return;
+	}
+
+	if(!isResident())
+		beginInitialize();
+	initializeSome(0, 0);
+}
+
+
+void Level::beginInitialize() {
 	dbgLogger.info("Initialize level ", _path);
 
 	AssetSP asset = _mainState->assets()->getAsset(_path);
@@ -109,43 +130,165 @@ void Level::initialize() {
 	lairAssert(_tileMap);
 
 	_entityMap.clear();
-	if(_levelRoot.isValid())
-		_levelRoot.destroy();
+	_objects.clear();
+	_arena.clear();
 	_levelRoot = _mainState->_entities.createEntity(_mainState->_world, _path.utf8CStr());
 	_levelRoot.setEnabled(false);
 
 	_baseLayer = createLayer(0, "layer_base");
 
-	for(int oli = 0; oli < _tileMap->nObjectLayer(); ++oli) {
-		for(const Json::Value& obj: _tileMap->objectLayer(oli)["objects"]) {
-			std::string type = obj.get("type", "<no_type>").asString();
-			std::string name = obj.get("name", "<no_name>").asString();
+	_nextLayer  = 0;
+	_nextObject = 0;
+	_ready      = false;
+}
 
-			EntityRef entity;
-			if(type == "trigger") {
-				entity = createTrigger(obj, name);
-			}
-			else if(type == "item") {
-				entity = createItem(obj, name);
-			}
-			else if(type == "door") {
-				entity = createDoor(obj, name);
-			}
-			else if(type == "sprite") {
-				entity = createSprite(obj, name);
-			}
-			else if(type == "spawn") {
-				entity = _mainState->_entities.createEntity(_levelRoot, name.c_str());
-				entity.translation2() = objectBox(obj).center();
-				entity.extra() = obj["properties"];
-			}
 
-			if(!entity.isValid())
-				dbgLogger.warning(_path, ": Failed to load entity \"", name, "\" of type \"", type, "\"");
-			else
-				_entityMap.emplace(name, entity);
+bool Level::initializeSome(unsigned maxObjects, int64 budgetNs) {
+	lairAssert(isResident());
+
+	int64 start = _mainState->sys()->getTimeNs();
+	unsigned count = 0;
+	while(_nextLayer < _tileMap->nObjectLayer()) {
+		const Json::Value& objects = _tileMap->objectLayer(_nextLayer)["objects"];
+		if(_nextObject >= objects.size()) {
+			++_nextLayer;
+			_nextObject = 0;
+			continue;
+		}
+
+		// Always create at least one object so that loading progresses.
+		if(count && ((maxObjects && count >= maxObjects)
+		          || (budgetNs && int64(_mainState->sys()->getTimeNs()) - start >= budgetNs)))
+			return false;
+
+		createObject(objects[Json::ArrayIndex(_nextObject)]);
+		++_nextObject;
+		++count;
+	}
+
+	if(!_ready)
+		endInitialize();
+	return true;
+}
+
+
+void Level::createObject(const Json::Value& obj) {
+	std::string type = obj.get("type", "<no_type>").asString();
+	std::string name = obj.get("name", "<no_name>").asString();
+
+	EntityRef entity;
+	const char* command = nullptr;
+	if(type == "trigger") {
+		entity = createTrigger(obj, name);
+	}
+	else if(type == "item") {
+		entity = createItem(obj, name);
+	}
+	else if(type == "door") {
+		entity = createDoor(obj, name);
+	}
+	else if(type == "sprite") {
+		entity = createSprite(obj, name);
+	}
+	else if(type == "spawn") {
+		entity = _mainState->_entities.createEntity(_levelRoot, name.c_str());
+		entity.translation2() = objectBox(obj).center();
+		entity.updateWorldTransform();
+		command = _arena.copyString(obj["properties"].get("on_enter", "fade_in").asString());
+	}
+
+	if(!entity.isValid()) {
+		dbgLogger.warning(_path, ": Failed to load entity \"", name, "\" of type \"", type, "\"");
+		return;
+	}
+
+	_entityMap.emplace(name, entity);
+
+	ObjectState state = captureState(entity, type == "door");
+	state.command = command;
+	_objects.push_back(state);
+}
+
+
+void Level::endInitialize() {
+	_ready = true;
+
+	if(!_evictedState.empty()) {
+		if(_evictedState.size() == _objects.size()) {
+			for(unsigned i = 0; i < _objects.size(); ++i)
+				applyState(_objects[i].entity, _evictedState[i]);
+		}
+		else {
+			dbgLogger.warning(_path, ": Object count changed since eviction, state is lost.");
+		}
+		_evictedState.clear();
+	}
+}
+
+
+void Level::reset() {
+	// An evicted level will be rebuilt from scratch.
+	_evictedState.clear();
+	if(!isResident())
+		return;
+
+	// Objects of a partially built level are not all there: abort the build.
+	if(!_ready) {
+		evict();
+		return;
+	}
+
+	dbgLogger.info("Reset level ", _path);
+	_levelRoot.setEnabled(false);
+	_mainState->setAllTransformsDirty();
+
+	for(ObjectState& state: _objects) {
+		applyState(state.entity, state);
+	}
+}
+
+
+void Level::evict() {
+	if(!isResident())
+		return;
+
+	dbgLogger.info("Evict level ", _path);
+
+	// A partially built level still holds the state it is meant to be
+	// rebuilt with (from a previous eviction or a snapshot), if any: keep it.
+	if(_ready) {
+		_evictedState.clear();
+		_evictedState.reserve(_objects.size());
+		for(ObjectState& state: _objects) {
+			_evictedState.push_back(captureState(state.entity, state.doorOpen >= 0));
+			_evictedState.back().entity = EntityRef();
 		}
 	}
+
+	_levelRoot.destroy();
+	_levelRoot.release();
+	_baseLayer.release();
+
+	_entityMap.clear();
+	ObjectStates().swap(_objects);
+	_arena.clear();
+	_tileMap.reset();
+	_ready = false;
+}
+
+
+std::size_t Level::memoryUsage() const {
+	std::size_t size = sizeof(Level)
+	                 + _evictedState.capacity() * sizeof(ObjectState);
+	if(!isResident())
+		return size;
+
+	size += _arena.capacity();
+	size += _objects.capacity() * sizeof(ObjectState);
+	size += _entityMap.size() * (sizeof(EntityMap::value_type) + 2 * sizeof(void*));
+	size += (_objects.size() + 2) * ENTITY_MEMORY_ESTIMATE;
+
+	return size;
 }
 
 
@@ -157,6 +300,11 @@ void Level::start(const std::string& spawn) {
 	if(spawnEntity.isValid())
 		_mainState->_player.place((Vector3() << spawnEntity.translation2(), .1).finished());
 
+	// Entities of the level may have been created or reset since their
+	// world transform was last computed, and triggers need them up to date.
+	_mainState->setAllTransformsDirty();
+	_mainState->updateWorldTransforms();
+
 	HitEventQueue hitQueue;
 	_mainState->_collisions.findCollisions(hitQueue);
 	_mainState->updateTriggers(hitQueue, EntityRef(), true);
@@ -164,7 +312,7 @@ void Level::start(const std::string& spawn) {
 	_mainState->orientPlayer(_mainState->_playerDir);
 
 	_mainState->setOverlay(1);
-	_mainState->exec(spawnEntity.extra().get("on_enter", "fade_in").asString());
+	_mainState->exec(spawnCommand(spawnEntity));
 }
 
 
@@ -174,6 +322,136 @@ void Level::stop() {
 }
 
 
+void Level::resume() {
+	dbgLogger.info("Resume level ", _path);
+	_levelRoot.setEnabled(true);
+}
+
+
+void Level::saveState(StateWriter& out) const {
+	// A level being initialized has not been played since it was evicted
+	// or reset: its state is the one saved at eviction, if any.
+	if(!_ready) {
+		out.write(uint32(_evictedState.size()));
+		for(const ObjectState& state: _evictedState)
+			writeState(out, state);
+		return;
+	}
+
+	out.write(uint32(_objects.size()));
+	for(const ObjectState& object: _objects)
+		writeState(out, captureState(object.entity, object.doorOpen >= 0));
+}
+
+
+bool Level::loadState(StateReader& in) {
+	uint32 count = 0;
+	if(!in.read(count))
+		return false;
+
+	if(count == 0) {
+		reset();
+		return true;
+	}
+
+	ObjectState state;
+	if(_ready && count == _objects.size()) {
+		for(unsigned i = 0; i < count; ++i) {
+			if(!readState(in, state))
+				return false;
+			applyState(_objects[i].entity, state);
+		}
+		return true;
+	}
+
+	if(_ready) {
+		dbgLogger.warning(_path, ": Object count changed since the snapshot, state is lost.");
+		for(unsigned i = 0; i < count; ++i) {
+			if(!readState(in, state))
+				return false;
+		}
+		reset();
+		return true;
+	}
+
+	// Applied by endInitialize() once the level is (re)built.
+	_evictedState.clear();
+	for(unsigned i = 0; i < count; ++i) {
+		if(!readState(in, state))
+			return false;
+		state.entity = EntityRef();
+		_evictedState.push_back(state);
+	}
+
+	return true;
+}
+
+
+Level::ObjectState Level::captureState(EntityRef entity, bool isDoor) const {
+	SpriteComponent* sc = _mainState->_sprites.get(entity);
+
+	ObjectState state;
+	state.entity    = entity;
+	state.position  = entity.transform().translation();
+	state.enabled   = entity.isEnabled();
+	state.tileIndex = sc? int(sc->tileIndex()): -1;
+	state.doorOpen  = isDoor? isDoorOpen(_mainState, entity): -1;
+	state.command   = nullptr;
+
+	return state;
+}
+
+
+void Level::applyState(EntityRef entity, const ObjectState& state) {
+	entity.place(state.position);
+	entity.setEnabled(state.enabled);
+	_mainState->setTransformDirty(entity);
+
+	SpriteComponent* sc = _mainState->_sprites.get(entity);
+	if(sc && state.tileIndex >= 0)
+		sc->setTileIndex(state.tileIndex);
+
+	if(state.doorOpen >= 0)
+		setDoorOpen(_mainState, entity, state.doorOpen);
+
+	TriggerComponent* tc = _mainState->_triggers.get(entity);
+	if(tc) {
+		tc->prevInside = false;
+		tc->inside     = false;
+	}
+}
+
+
+void Level::writeState(StateWriter& out, const ObjectState& state) {
+	out.write(state.position(0));
+	out.write(state.position(1));
+	out.write(state.position(2));
+	out.write(Byte(state.enabled));
+	out.write(std::int16_t(state.tileIndex));
+	out.write(std::int8_t(state.doorOpen));
+}
+
+
+bool Level::readState(StateReader& in, ObjectState& state) {
+	Byte         enabled   = 0;
+	std::int16_t tileIndex = 0;
+	std::int8_t  doorOpen  = 0;
+	in.read(state.position(0));
+	in.read(state.position(1));
+	in.read(state.position(2));
+	in.read(enabled);
+	in.read(tileIndex);
+	in.read(doorOpen);
+
+	state.enabled   = enabled;
+	state.tileIndex = tileIndex;
+	state.doorOpen  = doorOpen;
+	state.command   = nullptr;
+
+	return in.ok();
+}
+
+
 Box2 Level::objectBox(const Json::Value& obj) const {
 	try {
 		Json::Value props = obj["properties"];
@@ -319,6 +597,15 @@ Level::EntityRange Level::entities(const std::string& name) {
 }
 
 
+const char* Level::spawnCommand(EntityRef spawn) const {
+	for(const ObjectState& state: _objects) {
+		if(state.entity == spawn && state.command)
+			return state.command;
+	}
+	return "fade_in";
+}
+
+
 void Level::computeCollisions() {
 	// FIXME: The character can be stuck while sliding against a wall. Compute
 	// collision against thin walls.
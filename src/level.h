@@ -24,6 +24,7 @@
 
 
 #include <map>
+#include <vector>
 
 #include <lair/core/lair.h>
 #include <lair/core/path.h>
@@ -33,6 +34,9 @@
 #include <lair/ec/entity.h>
 #include <lair/ec/collision_component.h>
 
+#include "arena.h"
+#include "save_state.h"
+
 
 using namespace lair;
 
@@ -63,9 +67,32 @@ public:
 
 	void preload();
 	void initialize();
+	void reset();
+	void evict();
+
+	// Incremental initialization: create at most maxObjects objects, or stop
+	// after budgetNs nanoseconds (0 means no limit). Returns isReady().
+	void beginInitialize();
+	bool initializeSome(unsigned maxObjects, int64 budgetNs);
+
+	bool isResident() const { return _levelRoot.isValid(); }
+	bool isReady() const { return _ready; }
+	uint64 lastUse() const { return _lastUse; }
+	void setLastUse(uint64 lastUse) { _lastUse = lastUse; }
+	// Estimate of the memory evict() would free: objects, entities and
+	// strings of the level. The tile map and textures belong to the asset
+	// manager and stay loaded, so they are not counted.
+	std::size_t memoryUsage() const;
 
 	void start(const std::string& spawn);
 	void stop();
+	// Enable the level without spawning the player, when loading a snapshot.
+	void resume();
+
+	// State of the objects that can change while playing. A level without
+	// saved state is reset by loadState().
+	void saveState(StateWriter& out) const;
+	bool loadState(StateReader& in);
 
 	Box2 objectBox(const Json::Value& obj) const;
 
@@ -80,6 +107,7 @@ public:
 	EntityRef   root() { return _levelRoot; }
 	EntityRef   entity(const std::string& name);
 	EntityRange entities(const std::string& name);
+	const char* spawnCommand(EntityRef spawn) const;
 
 	void computeCollisions();
 
@@ -92,6 +120,44 @@ protected:
 	EntityRef  _baseLayer;
 	EntityMap  _entityMap;
 
+	// Initial state of the objects that can change while playing, used to
+	// restart the level without recreating its entities.
+	struct ObjectState {
+		EntityRef   entity;
+		Vector3     position;
+		bool        enabled;
+		int         tileIndex;
+		int         doorOpen;
+		const char* command;
+	};
+	typedef std::vector<ObjectState> ObjectStates;
+
+	void createObject(const Json::Value& obj);
+	void endInitialize();
+
+	ObjectState captureState(EntityRef entity, bool isDoor) const;
+	void applyState(EntityRef entity, const ObjectState& state);
+
+	static void writeState(StateWriter& out, const ObjectState& state);
+	static bool readState(StateReader& in, ObjectState& state);
+
+	ObjectStates _objects;
+
+	// State of the objects when the level was evicted, restored when it is
+	// rebuilt so that eviction does not change the game.
+	ObjectStates _evictedState;
+
+	unsigned     _nextLayer;
+	unsigned     _nextObject;
+	bool         _ready;
+
+	uint64       _lastUse;
+
+	// Holds the spawn commands referenced by _objects, cleared along with
+	// it. Trigger commands are owned by their components, which can outlive
+	// the level's entities until the trigger manager is compacted.
+	Arena        _arena;
+
 public:
 	struct EntityRange {
 		struct EntityIterator;
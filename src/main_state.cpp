@@ -19,7 +19,12 @@
  */
 
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
 #include <functional>
+#include <iterator>
 
 #include <lair/core/json.h>
 
@@ -51,6 +56,7 @@ MainState::MainState(Game* game)
       _entities(log()),
 
       _spriteRenderer(renderer()),
+      _renderScaler(renderer()),
       _sprites(assets(), loader(), &_mainPass, &_spriteRenderer),
       _texts(loader(), &_mainPass, &_spriteRenderer),
       _tileLayers(&_mainPass, &_spriteRenderer),
@@ -61,22 +67,51 @@ MainState::MainState(Game* game)
       _inputs(sys(), &log()),
 
       _camera(),
+      _hudCamera(),
+      _soundPlayer(audio()),
+      _soundVoices(16),
+      _soundFalloff(0),
+      _buttonSound(NO_SOUND),
+      _doorSound(NO_SOUND),
+      _footstepSound(NO_SOUND),
+      _menuSound(NO_SOUND),
+      _tpSound(NO_SOUND),
 
       _initialized(false),
       _running(false),
       _loop(sys()),
+      _allTransformsDirty(true),
       _fpsTime(0),
       _fpsCount(0),
+      _skipCount(0),
       _prevFrameTime(0),
+      _lastChangeTime(0),
+      _lastRenderTime(0),
+      _prevFrameRendered(false),
 
       _quitInput    (nullptr),
       _restartInput (nullptr),
+      _saveInput    (nullptr),
+      _loadInput    (nullptr),
       _upInput      (nullptr),
       _leftInput    (nullptr),
       _downInput    (nullptr),
       _rightInput   (nullptr),
       _useInput     (nullptr),
 
+      _levelClock(0),
+      _levelMemoryBudget(0),
+      _evictLevels(false),
+      _levelLoadBatch(0),
+      _levelLoadBudget(0),
+
+      _itemCount(),
+      _inventoryDirty(true),
+
+      _inventoryPool(&_entities),
+      _hudWindowSize(0, 0),
+      _hudDirty(true),
+
       _playerSpeed(8),
       _playerAnimSpeed(5),
       _fadeTime(.5)
@@ -120,16 +155,20 @@ void MainState::initialize() {
 	renderer()->context()->setLogCalls(false);
 
 	_loop.reset();
-	_loop.setTickDuration(  ONE_SEC / TICKRATE);
-	_loop.setFrameDuration( ONE_SEC / FRAMERATE);
+	_loop.setTickDuration(  ONE_SEC / game()->tickRate());
+	_loop.setFrameDuration( ONE_SEC / game()->frameRate());
 	_loop.setMaxFrameDuration(_loop.frameDuration() * 3);
 	_loop.setFrameMargin(     _loop.frameDuration() / 2);
 
+	_dirtyTransforms.reserve(MAX_DIRTY_TRANSFORMS);
+
 	window()->onResize.connect(std::bind(&MainState::resizeEvent, this))
 	        .track(_slotTracker);
 
 	_quitInput    = _inputs.addInput("quit");
 	_restartInput = _inputs.addInput("restart");
+	_saveInput    = _inputs.addInput("save");
+	_loadInput    = _inputs.addInput("load");
 	_upInput      = _inputs.addInput("up");
 	_leftInput    = _inputs.addInput("left");
 	_downInput    = _inputs.addInput("down");
@@ -138,6 +177,8 @@ void MainState::initialize() {
 
 	_inputs.mapScanCode(_quitInput,    SDL_SCANCODE_ESCAPE);
 	_inputs.mapScanCode(_restartInput, SDL_SCANCODE_F5);
+	_inputs.mapScanCode(_saveInput,    SDL_SCANCODE_F6);
+	_inputs.mapScanCode(_loadInput,    SDL_SCANCODE_F9);
 	_inputs.mapScanCode(_upInput,      SDL_SCANCODE_W);
 	_inputs.mapScanCode(_leftInput,    SDL_SCANCODE_A);
 	_inputs.mapScanCode(_downInput,    SDL_SCANCODE_S);
@@ -153,7 +194,15 @@ void MainState::initialize() {
 	_inputs.mapScanCode(_useInput,     SDL_SCANCODE_LCTRL);
 	_inputs.mapScanCode(_useInput,     SDL_SCANCODE_RCTRL);
 
-	parseJson(_messages, loader()->realFromLogic("text.json"), "text.json", dbgLogger);
+	_levelMemoryBudget = game()->config().get("level_memory_budget", 0).asUInt() * 1024;
+	_levelLoadBatch    = game()->config().get("level_load_batch", 0).asUInt();
+	_levelLoadBudget   = game()->config().get("level_load_budget_us", 4000).asInt64() * 1000;
+
+	_renderScaler.setScaleRange(game()->config().get("min_render_scale", .5).asFloat(), 1);
+	_renderScaler.setEnabled(game()->config().get("dynamic_resolution", false).asBool());
+
+	_soundVoices  = game()->config().get("sound_voices", 16).asUInt();
+	_soundFalloff = game()->config().get("sound_falloff", 0).asFloat();
 
 	_models = _entities.createEntity(_entities.root(), "models");
 	_models.setEnabled(false);
@@ -162,15 +211,24 @@ void MainState::initialize() {
 
 	loader()->load<TileMapLoader>("lvl_0.json");
 
-	loader()->load<ImageLoader>("dialog_box.png");
-	loader()->load<ImageLoader>("bocal.png");
-
-	preloadSound("button.wav");
-	preloadSound("door.wav");
-	preloadSound("footstep.wav");
-	preloadSound("menu.wav");
-	preloadSound("radio.wav");
-	preloadSound("tp.wav");
+	// Textures used later on are uploaded here, so that showing them for the
+	// first time does not stall a frame.
+	preloadTexture("dialog_box.png");
+	preloadTexture("white.png");
+	preloadTexture("bocal.png");
+	preloadTexture("alien.png");
+	preloadTexture("buttons.png");
+	preloadTexture("consoles.png");
+	preloadTexture("consoles2.png");
+	preloadTexture("door_gem.png");
+	preloadTexture("credits.png");
+
+	loadSounds("sounds.json");
+	_buttonSound   = soundId("button.wav");
+	_doorSound     = soundId("door.wav");
+	_footstepSound = soundId("footstep.wav");
+	_menuSound     = soundId("menu.wav");
+	_tpSound       = soundId("tp.wav");
 
 	_playerModel = loadEntity("player.json", _models);
 	_collisions.get(_playerModel)->setHitMask(HIT_PLAYER_FLAG | HIT_SOLID_FLAG);
@@ -186,17 +244,31 @@ void MainState::initialize() {
 	_doorVModel = loadEntity("door_v.json", _models);
 	_collisions.get(_doorVModel)->setHitMask(HIT_SOLID_FLAG);
 
+	// Parsed while the loader decodes the assets queued above.
+	loadMessages(game()->config().get("language", "").asString());
+}
+
+
+void MainState::finishInitialize() {
 	loader()->waitAll();
 
+	for(SoundInfo& info: _sounds) {
+		SoundAspectSP aspect = info.asset? info.asset->aspect<SoundAspect>(): nullptr;
+		if(aspect && aspect->get() && info.volume >= 0)
+			aspect->get()->setVolume(info.volume);
+	}
+
 	renderer()->uploadPendingTextures();
 
-	Mix_Volume(-1, 64);
+	_soundPlayer.start(&_sounds, _soundVoices);
+	_soundPlayer.setVolume(.5);
 
 	_initialized = true;
 }
 
 
 void MainState::shutdown() {
+	_soundPlayer.stop();
 	_slotTracker.disconnectAll();
 
 	_initialized = false;
@@ -211,6 +283,9 @@ void MainState::run() {
 	_loop.start();
 	_fpsTime  = sys()->getTimeNs();
 	_fpsCount = 0;
+	_skipCount = 0;
+	_prevFrameRendered = false;
+	sceneChanged();
 
 	do {
 		switch(_loop.nextEvent()) {
@@ -243,12 +318,55 @@ void MainState::registerLevel(const Path& path) {
 }
 
 
-void MainState::exec(const std::string& cmd, EntityRef self) {
+void MainState::evictLevels() {
+	if(!_levelMemoryBudget)
+		return;
+
+	std::size_t usage = levelsMemoryUsage();
+	while(usage > _levelMemoryBudget) {
+		LevelSP lru;
+		for(auto& item: _levels) {
+			const LevelSP& level = item.second;
+			if(level != _level && level != _pendingLevel && level->isResident()
+			&& (!lru || level->lastUse() < lru->lastUse()))
+				lru = level;
+		}
+		if(!lru)
+			break;
+
+		usage -= lru->memoryUsage();
+		lru->evict();
+		usage += lru->memoryUsage();
+	}
+
+	dbgLogger.info("Levels memory usage: ", usage / 1024, " KiB (budget: ",
+	               _levelMemoryBudget / 1024, " KiB)");
+}
+
+
+std::size_t MainState::levelsMemoryUsage() const {
+	std::size_t usage = 0;
+	for(auto& item: _levels)
+		usage += item.second->memoryUsage();
+	return usage;
+}
+
+
+void MainState::exec(const char* cmd, EntityRef self) {
 #define MAX_CMD_ARGS 32
+#define MAX_CMD_SIZE 1024
+
+	// Scripts are tokenized in place, in a copy on the stack: commands may
+	// change whatever cmd points to.
+	char     tokens[MAX_CMD_SIZE];
+	unsigned size = std::strlen(cmd);
+	if(size >= MAX_CMD_SIZE) {
+		dbgLogger.warning("Command too long (", size, " characters), ignored.");
+		return;
+	}
+	std::memcpy(tokens, cmd, size + 1);
 
-	std::string tokens = cmd;
-	unsigned    size   = tokens.size();
-	for(int ci = 0; ci < size; ) {
+	for(unsigned ci = 0; ci < size; ) {
 		int   argc = 0;
 		const char* argv[MAX_CMD_ARGS];
 		while(ci < size) {
@@ -261,7 +379,8 @@ void MainState::exec(const std::string& cmd, EntityRef self) {
 			if(endLine)
 				break;
 
-			argv[argc] = tokens.data() + ci;
+			if(argc < MAX_CMD_ARGS)
+				argv[argc] = tokens + ci;
 			++argc;
 
 			while(ci < size && !std::isspace(tokens[ci])) {
@@ -269,8 +388,22 @@ void MainState::exec(const std::string& cmd, EntityRef self) {
 			}
 		}
 
-		if(argc) {
+		if(argc > MAX_CMD_ARGS) {
+			dbgLogger.warning("Too many arguments for command \"", argv[0], "\", ignored.");
+		}
+		else if(argc) {
+			bool wasPending = bool(_pendingLevel);
 			exec(argc, argv, self);
+
+			// The next commands expect the new level, defer them until it
+			// is ready.
+			if(!wasPending && _pendingLevel) {
+				if(ci < size) {
+					_pendingCommand.assign(cmd + ci, size - ci);
+					_pendingSelf = self;
+				}
+				return;
+			}
 		}
 	}
 }
@@ -278,6 +411,8 @@ void MainState::exec(const std::string& cmd, EntityRef self) {
 
 int MainState::exec(int argc, const char** argv, EntityRef self) {
 	lairAssert(argc > 0);
+	// Commands can change pretty much anything on screen.
+	sceneChanged();
 	echoCommand(this, self, argc, argv);
 	auto cmd = _commands.find(argv[0]);
 	if(cmd == _commands.end()) {
@@ -288,26 +423,10 @@ int MainState::exec(int argc, const char** argv, EntityRef self) {
 }
 
 
-void MainState::startGame(const Path& firstLevel) {
-	if(_world.isValid()) {
-		stopGame();
-	}
-
-	_messageQueue.clear();
-	_postCommand.clear();
-	_inventorySlots.clear();
-
-	_endingState = END_BOCAL_OFF;
-
+void MainState::createWorld() {
 	_world = _entities.createEntity(_entities.root(), "world");
 
 	_player = _entities.cloneEntity(_playerModel, _world);
-	_playerDir  = UP;
-	_playerAnim = 0;
-
-	for(auto item: _levels) {
-		item.second->initialize();
-	}
 
 	_hud = _entities.createEntity(_entities.root(), "hud");
 
@@ -335,6 +454,39 @@ void MainState::startGame(const Path& firstLevel) {
 	sc->setColor(Vector4(0, 0, 0, 1));
 	sc->setBlendingMode(BLEND_ALPHA);
 
+	// One slot per item in the inventory. Usually at most one item of each
+	// kind, the pool grows if there are more.
+	_inventoryPool.setModel(_itemHudModel, _hud);
+	_inventoryPool.reserve(ITEM_BG);
+	_inventorySlots.reserve(ITEM_BG);
+	_inventory.reserve(ITEM_BG);
+}
+
+
+void MainState::startGame(const Path& firstLevel) {
+	// Restarting reuses the existing entities: levels and HUD are reset in
+	// place instead of being destroyed and recreated.
+	if(!_world.isValid()) {
+		createWorld();
+	}
+
+	_pendingLevel.reset();
+	_pendingCommand.clear();
+	_messageQueue.clear();
+	_postCommand.clear();
+	clearInventory();
+
+	_endingState = END_BOCAL_OFF;
+
+	_playerDir  = UP;
+	_playerAnim = 0;
+
+	_dialogBox.setEnabled(false);
+
+	for(auto& item: _levels) {
+		item.second->reset();
+	}
+
 	startLevel(firstLevel);
 
 	loader()->waitAll();
@@ -361,20 +513,56 @@ void MainState::startLevel(const Path& level, const std::string& spawn) {
 			dbgLogger.error("Failed to load \"", level, "\".");
 			return;
 		}
+	}
 
-		_levels[level]->initialize();
+	LevelSP next = _levels[level];
+	if(!next->isReady()) {
+		// The level is created over the next ticks, see updateLevelLoading().
+		if(!next->isResident())
+			next->beginInitialize();
+		_pendingLevel = next;
+		_pendingSpawn = spawn;
+		setOverlay(1);
+		return;
 	}
 
+	switchLevel(next, spawn);
+}
+
+
+void MainState::switchLevel(LevelSP level, const std::string& spawn) {
 	if(_level)
 		_level->stop();
 
-	_level = _levels[level];
+	_level = level;
+	_level->setLastUse(++_levelClock);
 	_level->start(spawn);
 
+	// startLevel is usually called by a trigger, so destroying entities now
+	// would mess with updateTriggers(). Evict on next tick instead.
+	_evictLevels = true;
+
 	loader()->waitAll();
 }
 
 
+void MainState::updateLevelLoading() {
+	if(!_pendingLevel->initializeSome(_levelLoadBatch, _levelLoadBudget))
+		return;
+
+	LevelSP level = _pendingLevel;
+	_pendingLevel.reset();
+	switchLevel(level, _pendingSpawn);
+
+	if(!_pendingCommand.empty()) {
+		std::string cmd;
+		cmd.swap(_pendingCommand);
+		exec(cmd.c_str(), _pendingSelf);
+		_pendingSelf = EntityRef();
+	}
+}
+
+
 void MainState::stopGame() {
 	_world.destroy();
 	_hud.destroy();
@@ -386,6 +574,143 @@ void MainState::stopGame() {
 	_dialogText.release();
 	for(EntityRef& e: _inventorySlots)
 		e.release();
+	_inventorySlots.clear();
+	_inventoryPool.clear();
+	clearInventory();
+}
+
+
+bool MainState::saveState(SaveState& state) {
+	if(_state != STATE_PLAY || _pendingLevel || !_level || !_messageQueue.empty()) {
+		dbgLogger.warning("saveState: can only save while playing.");
+		return false;
+	}
+
+	state.clear();
+	StateWriter out(state);
+
+	out.write("LDSS", 4);
+	out.write(uint32(SAVE_STATE_VERSION));
+
+	out.writeString(_level->path().utf8String());
+	Vector3 pos = _player.transform().translation();
+	out.write(pos(0));
+	out.write(pos(1));
+	out.write(pos(2));
+	out.write(Byte(_playerDir));
+	out.write(Byte(_endingState));
+
+	out.write(Byte(_inventory.size()));
+	for(Item item: _inventory)
+		out.write(Byte(item));
+
+	out.write(uint32(_levels.size()));
+	for(auto& item: _levels) {
+		out.writeString(item.first.utf8String());
+		std::size_t block = out.beginBlock();
+		item.second->saveState(out);
+		out.endBlock(block);
+	}
+
+	return true;
+}
+
+
+bool MainState::loadState(const SaveState& state) {
+	StateReader in(state);
+
+	char   magic[4];
+	uint32 version = 0;
+	in.read(magic, 4);
+	in.read(version);
+	if(!in.ok() || std::memcmp(magic, "LDSS", 4) != 0 || version != SAVE_STATE_VERSION) {
+		dbgLogger.error("loadState: invalid snapshot.");
+		return false;
+	}
+
+	std::string levelPath;
+	Vector3     pos;
+	Byte        dir    = 0;
+	Byte        ending = 0;
+	Byte        nItems = 0;
+	in.readString(levelPath);
+	in.read(pos(0));
+	in.read(pos(1));
+	in.read(pos(2));
+	in.read(dir);
+	in.read(ending);
+	in.read(nItems);
+
+	auto levelIt = _levels.find(levelPath);
+	if(!in.ok() || levelIt == _levels.end() || dir >= 4 || ending > END_KILL) {
+		dbgLogger.error("loadState: invalid snapshot.");
+		return false;
+	}
+
+	// Nothing is changed before this point.
+	_pendingLevel.reset();
+	_pendingCommand.clear();
+	_messageQueue.clear();
+	_postCommand.clear();
+	_dialogBox.setEnabled(false);
+
+	clearInventory();
+	for(unsigned i = 0; i < nItems; ++i) {
+		Byte item = 0;
+		in.read(item);
+		addToInventory(Item(item));
+	}
+
+	// Reset every level first, so that those registered after the snapshot
+	// are back to their initial state.
+	for(auto& item: _levels)
+		item.second->reset();
+
+	uint32 nLevels = 0;
+	in.read(nLevels);
+	for(unsigned i = 0; i < nLevels && in.ok(); ++i) {
+		std::string path;
+		uint32      size = 0;
+		in.readString(path);
+		in.read(size);
+
+		auto it = _levels.find(path);
+		if(it == _levels.end())
+			in.skip(size);
+		else
+			it->second->loadState(in);
+	}
+
+	if(!in.ok()) {
+		dbgLogger.error("loadState: truncated snapshot.");
+		return false;
+	}
+
+	LevelSP level = levelIt->second;
+	if(!level->isReady())
+		level->initialize();
+	if(_level)
+		_level->stop();
+	_level = level;
+	_level->setLastUse(++_levelClock);
+	_level->resume();
+
+	_endingState = EndingState(ending);
+	_player.place(pos);
+	_playerDir  = Direction(dir);
+	_playerAnim = 0;
+	orientPlayer(_playerDir);
+
+	// Recompute which triggers the player is in without firing them.
+	setAllTransformsDirty();
+	updateWorldTransforms();
+	HitEventQueue hitQueue;
+	_collisions.findCollisions(hitQueue);
+	updateTriggers(hitQueue, EntityRef(), true);
+
+	setState(STATE_PLAY);
+
+	return true;
 }
 
 
@@ -399,13 +724,31 @@ void MainState::updateTick() {
 	if(_restartInput->justPressed()) {
 		startGame(game()->firstLevel());
 	}
+	if(_saveInput->justPressed()) {
+		if(saveState(_checkpoint))
+			dbgLogger.info("Checkpoint saved (", _checkpoint.size(), " bytes).");
+	}
+	if(_loadInput->justPressed() && !_checkpoint.empty()) {
+		if(!loadState(_checkpoint))
+			startGame(game()->firstLevel());
+	}
 	if (sys()->getKeyState(SDL_SCANCODE_F1)) {
 		renderer()->context()->setLogCalls(true);
 	}
 
-	_entities.setPrevWorldTransforms();
+	if(_evictLevels) {
+		evictLevels();
+		_evictLevels = false;
+	}
+
+	// Only the player moves continuously, other entities are tracked with
+	// setTransformDirty().
+	_player.setPrevWorldTransform();
 
-	if(_state == STATE_PLAY) {
+	if(_pendingLevel) {
+		updateLevelLoading();
+	}
+	else if(_state == STATE_PLAY && _level) {
 		// Player movement
 		Vector2 offset(0, 0);
 		if(_upInput->isPressed()) {
@@ -426,7 +769,7 @@ void MainState::updateTick() {
 		}
 
 		Vector2 lastPlayerPos = _player.translation2();
-		float playerSpeed = _playerSpeed * float(TILE_SIZE) / float(TICKRATE);
+		float playerSpeed = _playerSpeed * float(TILE_SIZE) * tickDuration();
 		if(!offset.isApprox(Vector2::Zero())) {
 			_player.translation2() += offset.normalized() * playerSpeed;
 		}
@@ -478,12 +821,13 @@ void MainState::updateTick() {
 		_player.translate(bump);
 
 		if(!_player.translation2().isApprox(lastPlayerPos)) {
+			sceneChanged();
 			float prevAnim = _playerAnim;
-			_playerAnim += _playerAnimSpeed / float(TICKRATE);
+			_playerAnim += _playerAnimSpeed * tickDuration();
 			orientPlayer(_playerDir, 1 + int(_playerAnim) % 2);
 
 			if(int(prevAnim) % 2 != int(_playerAnim) % 2)
-				playSound("footstep.wav");
+				playSound(_footstepSound);
 		}
 		else {
 			_playerAnim = 0;
@@ -493,7 +837,7 @@ void MainState::updateTick() {
 		_overlay.setEnabled(false);
 	}
 	else if(_state == STATE_FADE_IN || _state == STATE_FADE_OUT) {
-		_fadeAnim += 1. / (_fadeTime * float(TICKRATE));
+		_fadeAnim += tickDuration() / _fadeTime;
 
 		if(_state == STATE_FADE_IN) {
 			setOverlay(1 - _fadeAnim);
@@ -507,17 +851,59 @@ void MainState::updateTick() {
 	}
 	else if(!_messageQueue.empty()) {
 		if(_useInput->justPressed()) {
-			playSound("menu.wav");
+			playSound(_menuSound);
 			nextMessage();
 		}
 	}
 
 	// WARNING: returning early might skip updateWorldTransform.
-	_entities.updateWorldTransforms();
+	updateWorldTransforms();
 }
 
 
 void MainState::updateFrame() {
+	if(_inventoryDirty)
+		updateInventoryHud();
+	if(_hudDirty || window()->width()  != _hudWindowSize(0)
+	             || window()->height() != _hudWindowSize(1))
+		layoutHud();
+
+	renderer()->uploadPendingTextures();
+
+	// Skip the frame if nothing changed since the last rendered one (one
+	// tick of margin for interpolation), but still refresh from time to time.
+	uint64 now = sys()->getTimeNs();
+	bool idle = now - _lastChangeTime > 2 * uint64(_loop.tickDuration())
+	         && now - _lastRenderTime < ONE_SEC / IDLE_FRAMERATE;
+	if(idle) {
+		++_skipCount;
+		_prevFrameRendered = false;
+	}
+	else {
+		// Only consecutive rendered frames give a meaningful frame time, but
+		// all of them count, however slow.
+		if(_prevFrameRendered)
+			_renderScaler.updateScale(now - _lastRenderTime, _loop.frameDuration());
+
+		renderFrame();
+		_lastRenderTime    = now;
+		_prevFrameRendered = true;
+	}
+
+	++_fpsCount;
+	if(_fpsCount == game()->frameRate()) {
+		log().info("FPS: ", _fpsCount * float(ONE_SEC) / (now - _fpsTime),
+		           " (skipped: ", _skipCount, ")");
+		_fpsTime   = now;
+		_fpsCount  = 0;
+		_skipCount = 0;
+	}
+
+	_prevFrameTime = _loop.frameTime();
+}
+
+
+void MainState::renderFrame() {
 //	double time = double(_loop.frameTime()) / double(ONE_SEC);
 	double etime = double(_loop.frameTime() - _prevFrameTime) / double(ONE_SEC);
 
@@ -527,66 +913,92 @@ void MainState::updateFrame() {
 	             (Vector3() << playerPos + viewSize / 2, 1).finished());
 	_camera.setViewBox(viewBox);
 
-	float hudHeight = SCREEN_HEIGHT;
-	float hudScale = float(window()->height()) / hudHeight;
-	float hudWidth = float(window()->width()) / hudScale;
-
-	Transform hudTrans = Transform::Identity();
-	hudTrans.translate(Vector3(viewBox.min()));
-	hudTrans.scale(hudScale);
-	_hud.place(hudTrans);
-	_hud.setPrevWorldTransform();
-
-	_dialogBox.place(Vector3(hudWidth / 2, 40, .8));
-	_dialogBox.setPrevWorldTransform();
-
-	_dialogText.updateWorldTransform();
-	_dialogText.setPrevWorldTransform();
-
-	_overlay.transform().setIdentity();
-	_overlay.transform().translate(Vector3(hudWidth / 2, hudHeight / 2, .7));
-	_overlay.transform().scale(Vector3(hudWidth + 2, hudHeight + 2, 1));
-	_overlay.updateWorldTransform();
-	_overlay.setPrevWorldTransform();
-
-	for(int i=0; i < _inventorySlots.size(); ++i) {
-		EntityRef item = _inventorySlots[i];
-		item.place(Vector3(48 + 80 * i, hudHeight - 48, 0.6));
-		item.updateWorldTransform();
-		item.setPrevWorldTransform();
-	}
-
-	renderer()->uploadPendingTextures();
-
 	// Rendering
 	Context* glc = renderer()->context();
 
+	_renderScaler.beginFrame(window()->width(), window()->height());
+
 	glc->clearColor(0, 0, 0, 1);
 	glc->clear(gl::COLOR_BUFFER_BIT | gl::DEPTH_BUFFER_BIT);
 
 	_mainPass.clear();
 	_spriteRenderer.clear();
 
-	_sprites   .render(_entities.root(), _loop.frameInterp(), _camera);
-	_texts     .render(_entities.root(), _loop.frameInterp(), _camera);
-	_tileLayers.render(_entities.root(), _loop.frameInterp(), _camera);
+	_sprites   .render(_world, _loop.frameInterp(), _camera);
+	_texts     .render(_world, _loop.frameInterp(), _camera);
+	// Tile layers only exist in levels and only the current one is visible,
+	// so there is no need to walk the other resident levels.
+	if(_level)
+		_tileLayers.render(_level->root(), _loop.frameInterp(), _camera);
+
+	// The HUD lives in screen space and has its own camera.
+	_sprites   .render(_hud, _loop.frameInterp(), _hudCamera);
+	_texts     .render(_hud, _loop.frameInterp(), _hudCamera);
 
 	_mainPass.render();
 
+	_renderScaler.endFrame();
+
 	window()->swapBuffers();
 	glc->setLogCalls(false);
 
 //	dumpEntities(_entities.root(), 0);
+}
 
-	uint64 now = sys()->getTimeNs();
-	++_fpsCount;
-	if(_fpsCount == FRAMERATE) {
-		log().info("FPS: ", _fpsCount * float(ONE_SEC) / (now - _fpsTime));
-		_fpsTime  = now;
-		_fpsCount = 0;
+
+float MainState::tickDuration() const {
+	return float(_loop.tickDuration()) / float(ONE_SEC);
+}
+
+
+void MainState::sceneChanged() {
+	_lastChangeTime = sys()->getTimeNs();
+}
+
+
+void MainState::setTransformDirty(EntityRef entity) {
+	if(_allTransformsDirty
+	|| std::find(_dirtyTransforms.begin(), _dirtyTransforms.end(), entity) != _dirtyTransforms.end())
+		return;
+
+	// Past a few entities (e.g. a level reset), a full update is cheaper.
+	if(_dirtyTransforms.size() >= MAX_DIRTY_TRANSFORMS)
+		setAllTransformsDirty();
+	else
+		_dirtyTransforms.push_back(entity);
+}
+
+
+void MainState::setAllTransformsDirty() {
+	_allTransformsDirty = true;
+}
+
+
+void MainState::updateWorldTransforms() {
+	if(_allTransformsDirty) {
+		_entities.updateWorldTransforms();
+		_entities.setPrevWorldTransforms();
+		_dirtyTransforms.clear();
+		_allTransformsDirty = false;
+		return;
 	}
 
-	_prevFrameTime = _loop.frameTime();
+	_player.updateWorldTransform();
+
+	// Moved entities jump to their new position without interpolation.
+	for(EntityRef& entity: _dirtyTransforms) {
+		if(entity.isValid())
+			updateSubtreeTransforms(entity);
+	}
+	_dirtyTransforms.clear();
+}
+
+
+void MainState::updateSubtreeTransforms(EntityRef entity) {
+	entity.updateWorldTransform();
+	entity.setPrevWorldTransform();
+	for(EntityRef child = entity.firstChild(); child.isValid(); child = child.nextSibling())
+		updateSubtreeTransforms(child);
 }
 
 
@@ -596,7 +1008,7 @@ void MainState::updateTriggers(HitEventQueue& hitQueue, EntityRef useEntity, boo
 	if(useEntity.isValid()) {
 		TriggerComponent* tc = _triggers.get(useEntity);
 		if(tc && !tc->onUse.empty())
-			exec(tc->onUse, useEntity);
+			exec(tc->onUse.c_str(), useEntity);
 	}
 
 	for(TriggerComponent& tc: _triggers) {
@@ -624,9 +1036,9 @@ void MainState::updateTriggers(HitEventQueue& hitQueue, EntityRef useEntity, boo
 		for(TriggerComponent& tc: _triggers) {
 			if(tc.isEnabled() && tc.entity().isEnabledRec()) {
 				if(!tc.prevInside && tc.inside && !tc.onEnter.empty())
-					exec(tc.onEnter, tc.entity());
+					exec(tc.onEnter.c_str(), tc.entity());
 				if(tc.prevInside && !tc.inside && !tc.onExit.empty())
-					exec(tc.onExit, tc.entity());
+					exec(tc.onExit.c_str(), tc.entity());
 			}
 		}
 	}
@@ -634,20 +1046,59 @@ void MainState::updateTriggers(HitEventQueue& hitQueue, EntityRef useEntity, boo
 
 
 void MainState::popupMessage(const std::string& key) {
-	const Json::Value& messages = _messages.get(key, Json::nullValue);
-	if(!messages.isArray())
+	MessageId message = _messages.find(key);
+	if(_messages.nLines(message) == 0)
 		return;
 
-	for(const Json::Value& msg: messages)
-		enqueueMessage(msg.asString());
+	enqueueMessage(message);
 }
 
 
-void MainState::enqueueMessage(const std::string& message) {
-	_messageQueue.push_back(message);
-	if(_messageQueue.size() == 1) {
+void MainState::loadMessages(const std::string& language) {
+	// text.json is compiled into text.bin at build time (see
+	// compile_messages), which is memory-mapped. The game never writes it.
+	std::string name = language.empty()? "text": "text_" + language;
+	Path sourcePath = loader()->realFromLogic(name + ".json");
+	Path catalog    = loader()->realFromLogic(name + ".bin");
+
+	std::ifstream in(sourcePath.utf8CStr(), std::ios::binary);
+	bool hasSource = bool(in);
+	std::string source((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	// Without text.json (compiled catalog only), any valid catalog is used.
+	if(_messages.loadCatalog(catalog)) {
+		if(!hasSource || _messages.matchesSource(source)) {
+			dbgLogger.info("Messages: map \"", catalog, "\" (", _messages.size(), " bytes).");
+			return;
+		}
+		dbgLogger.error("Messages: \"", catalog, "\" is out of date, rebuild the game.");
+	}
+	if(!hasSource) {
+		dbgLogger.error("Messages: neither \"", sourcePath, "\" nor a valid \"", catalog, "\" found.");
+		_messages.clear();
+		return;
+	}
+
+	Json::Value messages;
+	if(!parseJson(messages, sourcePath, name + ".json", dbgLogger)) {
+		_messages.clear();
+		return;
+	}
+	_messages.load(messages, source);
+	dbgLogger.info("Messages: load \"", sourcePath, "\" (", _messages.size(), " bytes).");
+}
+
+
+void MainState::enqueueMessage(MessageId message) {
+	bool show = _messageQueue.empty();
+	if(!_messageQueue.push(message)) {
+		dbgLogger.warning("Message queue full, drop a message.");
+		return;
+	}
+	if(show) {
+		sceneChanged();
 		_dialogBox.setEnabled(true);
-		_texts.get(_dialogText)->setText(message);
+		_texts.get(_dialogText)->setText(_messages.line(message, 0));
 		setState(STATE_MESSAGE);
 	}
 }
@@ -657,18 +1108,18 @@ void MainState::setState(State state) {
 	std::string cmd;
 	if(_state != STATE_PLAY) {
 		// exec can set post command.
-		cmd = _postCommand;
-		_postCommand.clear();
+		cmd.swap(_postCommand);
 	}
 
 	dbgLogger.info("Set state: ", state);
 	_state = state;
+	sceneChanged();
 
 	if(_state == STATE_FADE_IN || _state == STATE_FADE_OUT)
 		_fadeAnim = 0;
 
 	if(!cmd.empty())
-		exec(cmd);
+		exec(cmd.c_str());
 }
 
 
@@ -693,11 +1144,12 @@ void MainState::setPostCommand(int argc, const char** argv) {
 
 
 void MainState::nextMessage() {
-	_messageQueue.pop_front();
-	bool show = _messageQueue.size();
+	sceneChanged();
+	bool show = _messageQueue.next(_messages);
 	_dialogBox.setEnabled(show);
 	if(show)
-		_texts.get(_dialogText)->setText(_messageQueue.front());
+		_texts.get(_dialogText)->setText(_messages.line(_messageQueue.frontMessage(),
+		                                                _messageQueue.frontLine()));
 	else {
 		setState(STATE_PLAY);
 	}
@@ -705,39 +1157,61 @@ void MainState::nextMessage() {
 
 
 bool MainState::hasItem(Item item) {
-	for(auto it = _inventorySlots.begin(); it != _inventorySlots.end(); ++it) {
-		EntityRef entity = *it;
-		if(_sprites.get(entity)->tileIndex() == item) {
-			return true;
-		}
-	}
-	return false;
+	return item >= 0 && item < ITEM_BG && _itemCount[item];
 }
 
 
 void MainState::addToInventory(Item item) {
+	if(item < 0 || item >= ITEM_BG) {
+		dbgLogger.warning("addToInventory: invalid item ", item, ".");
+		return;
+	}
+
 	dbgLogger.info("Add item ", item);
-	EntityRef entity = _entities.cloneEntity(_itemHudModel, _hud);
-	_sprites.get(entity)->setTileIndex(item);
-	_inventorySlots.push_back(entity);
+	++_itemCount[item];
+	_inventory.push_back(item);
+	_inventoryDirty = true;
 }
 
 
 void MainState::removeFromInventory(Item item) {
-	for(auto it = _inventorySlots.begin(); it != _inventorySlots.end(); ++it) {
-		EntityRef entity = *it;
-		if(_sprites.get(entity)->tileIndex() == item) {
-			dbgLogger.info("Remove item ", item);
-			entity.destroy();
-			_inventorySlots.erase(it);
-			return;
+	if(!hasItem(item)) {
+		lairAssert(false);
+		return;
+	}
+
+	dbgLogger.info("Remove item ", item);
+	--_itemCount[item];
+	_inventory.erase(std::find(_inventory.begin(), _inventory.end(), item));
+	_inventoryDirty = true;
+}
+
+
+void MainState::clearInventory() {
+	_inventory.clear();
+	std::fill(_itemCount, _itemCount + ITEM_BG, 0);
+	_inventoryDirty = true;
+}
+
+
+void MainState::updateInventoryHud() {
+	_inventoryPool.releaseAll();
+	_inventorySlots.clear();
+	if(_hud.isValid()) {
+		for(Item item: _inventory) {
+			EntityRef entity = _inventoryPool.acquire();
+			_sprites.get(entity)->setTileIndex(item);
+			_inventorySlots.push_back(entity);
 		}
 	}
-	lairAssert(false);
+
+	_inventoryDirty = false;
+	_hudDirty       = true;
 }
 
 
 void MainState::setOverlay(float opacity, const Vector4& color) {
+	sceneChanged();
 	_overlay.setEnabled(opacity > 0.001);
 	Vector4 c = color;
 	c(3) = opacity;
@@ -747,23 +1221,79 @@ void MainState::setOverlay(float opacity, const Vector4& color) {
 }
 
 
-void MainState::preloadSound(const Path& sound) {
-	loader()->load<SoundLoader>(sound);
-	_soundMap.emplace(sound, _soundMap.size());
+void MainState::preloadTexture(const Path& texture) {
+	// Same texture aspect SpriteComponent::setTexture() looks up later, it
+	// is uploaded by the next call to uploadPendingTextures(). Sampling flags
+	// are set by each sprite at draw time.
+	AssetSP asset = loader()->loadAsset<ImageLoader>(texture);
+	if(!asset->aspect<TextureAspect>())
+		renderer()->createTexture(asset);
 }
 
 
-void MainState::playSound(const Path& sound) {
-	int chann = 0;
-	if(_soundMap.count(sound))
-		chann = _soundMap[sound];
+void MainState::loadSounds(const Path& manifest) {
+	Json::Value json;
+	if(!parseJson(json, loader()->realFromLogic(manifest), manifest, dbgLogger))
+		return;
+
+	for(auto it = json.begin(); it != json.end(); ++it) {
+		preloadSound(it.key().asString(), *it);
+	}
+}
+
+
+SoundId MainState::preloadSound(const Path& sound, const Json::Value& settings) {
+	auto it = _soundMap.find(sound);
+	if(it != _soundMap.end())
+		return it->second;
+
+	SoundId id = _sounds.size();
+	SoundInfo info;
+	info.asset   = loader()->loadAsset<SoundLoader>(sound);
+	info.volume       = settings.get("volume", -1).asFloat();
+	info.priority     = settings.get("priority", 0).asInt();
+	info.maxInstances = settings.get("max_instances", 0).asUInt();
+	info.positional   = settings.get("positional", false).asBool();
+	_sounds.push_back(info);
+	_soundMap.emplace(sound, id);
+
+	return id;
+}
+
+
+SoundId MainState::soundId(const Path& sound) const {
+	auto it = _soundMap.find(sound);
+	if(it == _soundMap.end()) {
+		dbgLogger.warning("Sound \"", sound, "\" is not preloaded.");
+		return NO_SOUND;
+	}
+	return it->second;
+}
+
+
+void MainState::playSound(SoundId sound, EntityRef source) {
+	if(sound < 0 || sound >= int(_sounds.size()))
+		return;
 
-	AssetSP asset = assets()->getAsset(sound);
+	const SoundInfo& info = _sounds[sound];
+	Uint8 distance = 0;
+	if(info.positional && source.isValid() && _soundFalloff > 0) {
+		float dist = (source.translation2() - _player.translation2()).norm();
+		distance = Uint8(std::min(dist / _soundFalloff, 1.f) * 255);
+	}
+	if(!_soundPlayer.play(sound, distance))
+		dbgLogger.warning("Sound queue full, drop a sound.");
+}
 
-	if(sound == "footstep.wav")
-		asset->aspect<SoundAspect>()->get()->setVolume(.15);
 
-	audio()->playSound(asset, 0, chann);
+void MainState::playSound(const Path& sound) {
+	playSound(soundId(sound));
+}
+
+
+void MainState::playMusic(AssetSP music, float volume) {
+	if(!_soundPlayer.playMusic(music, volume))
+		dbgLogger.warning("Sound queue full, drop the music.");
 }
 
 
@@ -771,7 +1301,11 @@ void MainState::orientPlayer(Direction dir, int frame) {
 	static int playerTileMap[] = { 9, 3, 0, 6 };
 
 	SpriteComponent* playerSprite = _sprites.get(_player);
-	playerSprite->setTileIndex(playerTileMap[dir] + frame);
+	unsigned tileIndex = playerTileMap[dir] + frame;
+	if(playerSprite->tileIndex() != tileIndex) {
+		playerSprite->setTileIndex(tileIndex);
+		sceneChanged();
+	}
 }
 
 
@@ -787,6 +1321,38 @@ EntityRef MainState::createTrigger(EntityRef parent, const char* name, const Box
 }
 
 
+void MainState::layoutHud() {
+	sceneChanged();
+	_hudWindowSize = Vector2i(window()->width(), window()->height());
+
+	float hudHeight = SCREEN_HEIGHT;
+	float hudWidth  = hudHeight * float(_hudWindowSize(0)) / float(_hudWindowSize(1));
+
+	_hudCamera.setViewBox(Box3(Vector3::Zero(), Vector3(hudWidth, hudHeight, 1)));
+
+	_dialogBox.place(Vector3(hudWidth / 2, 40, .8));
+	_dialogBox.setPrevWorldTransform();
+
+	_dialogText.updateWorldTransform();
+	_dialogText.setPrevWorldTransform();
+
+	_overlay.transform().setIdentity();
+	_overlay.transform().translate(Vector3(hudWidth / 2, hudHeight / 2, .7));
+	_overlay.transform().scale(Vector3(hudWidth + 2, hudHeight + 2, 1));
+	_overlay.updateWorldTransform();
+	_overlay.setPrevWorldTransform();
+
+	for(int i=0; i < _inventorySlots.size(); ++i) {
+		EntityRef item = _inventorySlots[i];
+		item.place(Vector3(48 + 80 * i, hudHeight - 48, 0.6));
+		item.updateWorldTransform();
+		item.setPrevWorldTransform();
+	}
+
+	_hudDirty = false;
+}
+
+
 void MainState::resizeEvent() {
 	renderer()->context()->viewport(0, 0, window()->width(), window()->height());
 }
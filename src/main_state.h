@@ -44,6 +44,11 @@
 #include <lair/ec/collision_component.h>
 
 #include "components.h"
+#include "entity_pool.h"
+#include "message_table.h"
+#include "render_scaler.h"
+#include "save_state.h"
+#include "sound_player.h"
 
 
 #define ONE_SEC (1000000000)
@@ -51,13 +56,22 @@
 #define SCREEN_WIDTH  1920
 #define SCREEN_HEIGHT 1080
 
+// Default rates, see Game::initialize().
 #define FRAMERATE 60
 #define TICKRATE  60
 
+#define LOW_POWER_FRAMERATE 30
+#define LOW_POWER_TICKRATE  30
+// Refresh rate when nothing changes on screen.
+#define IDLE_FRAMERATE 4
+
 #define TILE_SIZE       48
 #define TILE_SET_WIDTH  12
 #define TILE_SET_HEIGHT 12
 
+// Entities tracked by setTransformDirty() before falling back to a full update.
+#define MAX_DIRTY_TRANSFORMS 64
+
 #define HIT_PLAYER_FLAG  0x01
 #define HIT_TRIGGER_FLAG 0x02
 #define HIT_USE_FLAG     0x04
@@ -107,7 +121,7 @@ typedef std::unordered_map<Path, LevelSP, boost::hash<Path>> LevelMap;
 typedef int (*Command)(MainState* state, EntityRef self, int argc, const char** argv);
 typedef std::unordered_map<std::string, Command> CommandMap;
 
-typedef std::unordered_map<Path, int, boost::hash<Path>> SoundMap;
+typedef std::unordered_map<Path, SoundId, boost::hash<Path>> SoundMap;
 
 
 class MainState : public GameState {
@@ -115,7 +129,9 @@ public:
 	MainState(Game* game);
 	virtual ~MainState();
 
+	// initialize() only queues the assets, finishInitialize() waits for them.
 	virtual void initialize();
+	void finishInitialize();
 	virtual void shutdown();
 
 	virtual void run();
@@ -124,15 +140,38 @@ public:
 	Game* game();
 
 	void registerLevel(const Path& path);
-	void exec(const std::string& cmd, EntityRef self = EntityRef());
+	void evictLevels();
+	std::size_t levelsMemoryUsage() const;
+	void exec(const char* cmd, EntityRef self = EntityRef());
 	int exec(int argc, const char** argv, EntityRef self = EntityRef());
 
+	void createWorld();
 	void startGame(const Path& firstLevel);
 	void startLevel(const Path& level, const std::string& spawn = "spawn");
+	void switchLevel(LevelSP level, const std::string& spawn);
+	void updateLevelLoading();
 	void stopGame();
 
+	// Snapshot of the mutable game state. Only possible while playing, not
+	// during a dialog, a fade or a level load. loadState() patches the
+	// existing entities in place.
+	bool saveState(SaveState& state);
+	bool loadState(const SaveState& state);
+
 	void updateTick();
 	void updateFrame();
+	void renderFrame();
+
+	// Duration of a tick, in seconds.
+	float tickDuration() const;
+
+	// Call when something visible changed, see updateFrame().
+	void sceneChanged();
+
+	void setTransformDirty(EntityRef entity);
+	void setAllTransformsDirty();
+	void updateWorldTransforms();
+	void updateSubtreeTransforms(EntityRef entity);
 
 	void updateTriggers(HitEventQueue& hitQueue, EntityRef useEntity, bool disableCmds = false);
 
@@ -143,18 +182,26 @@ public:
 	void setPostCommand(const std::string& command);
 	void setPostCommand(int argc, const char** argv);
 
+	void loadMessages(const std::string& language);
 	void popupMessage(const std::string& key);
-	void enqueueMessage(const std::string& message);
+	void enqueueMessage(MessageId message);
 	void nextMessage();
 
 	bool hasItem(Item item);
 	void addToInventory(Item item);
 	void removeFromInventory(Item item);
+	void clearInventory();
+	void updateInventoryHud();
 
 	void setOverlay(float opacity, const Vector4& color = Vector4(0, 0, 0, 1));
 
-	void preloadSound(const Path& sound);
+	void preloadTexture(const Path& texture);
+	void loadSounds(const Path& manifest);
+	SoundId preloadSound(const Path& sound, const Json::Value& settings = Json::Value());
+	SoundId soundId(const Path& sound) const;
+	void playSound(SoundId sound, EntityRef source = EntityRef());
 	void playSound(const Path& sound);
+	void playMusic(AssetSP music, float volume);
 
 	void orientPlayer(Direction dir, int frame = 0);
 
@@ -162,6 +209,7 @@ public:
 
 	// Stuff
 
+	void layoutHud();
 	void resizeEvent();
 
 	EntityRef loadEntity(const Path& path, EntityRef parent,
@@ -178,6 +226,7 @@ public:
 	EntityManager              _entities;
 
 	SpriteRenderer             _spriteRenderer;
+	RenderScaler               _renderScaler;
 	SpriteComponentManager     _sprites;
 	BitmapTextComponentManager _texts;
 	TileLayerComponentManager  _tileLayers;
@@ -192,24 +241,47 @@ public:
 
 	State       _state;
 	CommandMap  _commands;
-	Json::Value _messages;
+	MessageTable _messages;
 	std::string _postCommand;
-	std::deque<std::string> _messageQueue;
+	MessageQueue _messageQueue;
 	OrthographicCamera _camera;
-	SoundMap _soundMap;
+	OrthographicCamera _hudCamera;
+	SoundMap    _soundMap;
+	SoundList   _sounds;
+	SoundPlayer _soundPlayer;
+	unsigned    _soundVoices;
+	// Distance at which positional sounds become silent. 0 disables it.
+	float       _soundFalloff;
+
+	// Sounds played by the code.
+	SoundId _buttonSound;
+	SoundId _doorSound;
+	SoundId _footstepSound;
+	SoundId _menuSound;
+	SoundId _tpSound;
 
 	EndingState _endingState;
 
 	bool       _initialized;
 	bool       _running;
 	InterpLoop _loop;
+	// Entities (other than the player) moved during the current tick.
+	std::vector<EntityRef> _dirtyTransforms;
+	bool       _allTransformsDirty;
 	int64      _fpsTime;
 	unsigned   _fpsCount;
+	unsigned   _skipCount;
 	uint64     _prevFrameTime;
+	uint64     _lastChangeTime;
+	uint64     _lastRenderTime;
+	// Whether the previous frame was rendered rather than skipped as idle.
+	bool       _prevFrameRendered;
 	float      _fadeAnim;
 
 	Input* _quitInput;
 	Input* _restartInput;
+	Input* _saveInput;
+	Input* _loadInput;
 	Input* _upInput;
 	Input* _leftInput;
 	Input* _downInput;
@@ -218,6 +290,19 @@ public:
 
 	LevelMap  _levels;
 	LevelSP   _level;
+	uint64    _levelClock;
+	// Maximum memory used by resident levels, in bytes. 0 means no limit.
+	std::size_t _levelMemoryBudget;
+	bool      _evictLevels;
+
+	// Level being initialized incrementally, started once ready.
+	LevelSP     _pendingLevel;
+	std::string _pendingSpawn;
+	// Rest of the script that started _pendingLevel, run once it is started.
+	std::string _pendingCommand;
+	EntityRef   _pendingSelf;
+	unsigned    _levelLoadBatch;
+	int64       _levelLoadBudget;
 
 	// Models
 	EntityRef _models;
@@ -233,12 +318,23 @@ public:
 	Direction _playerDir;
 	float     _playerAnim;
 
+	// Inventory in pickup order, and number of items of each kind. The HUD
+	// slots are only a view of it, rebuilt by updateInventoryHud().
+	std::vector<Item> _inventory;
+	unsigned  _itemCount[ITEM_BG];
+	bool      _inventoryDirty;
+
+	SaveState _checkpoint;
+
 	// HUD entities
 	EntityRef _hud;
 	EntityRef _dialogBox;
 	EntityRef _dialogText;
 	std::vector<EntityRef> _inventorySlots;
+	EntityPool _inventoryPool;
 	EntityRef _overlay;
+	Vector2i  _hudWindowSize;
+	bool      _hudDirty;
 
 	// Game params
 	float _playerSpeed;
@@ -0,0 +1,63 @@
+/*
+ *  Copyright (C) 2016 the authors (see AUTHORS)
+ *
+ *  This file is part of ld36.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#ifndef LD36_MAPPED_FILE_H
+#define LD36_MAPPED_FILE_H
+
+
+#include <cstddef>
+
+#include <lair/core/lair.h>
+#include <lair/core/path.h>
+
+
+using namespace lair;
+
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+public:
+	MappedFile();
+	MappedFile(const MappedFile&)  = delete;
+	MappedFile(      MappedFile&&) = delete;
+	~MappedFile();
+
+	MappedFile& operator=(const MappedFile&)  = delete;
+	MappedFile& operator=(      MappedFile&&) = delete;
+
+	bool open(const Path& path);
+	void close();
+
+	bool        isOpen() const { return _data; }
+	const Byte* data()   const { return _data; }
+	std::size_t size()   const { return _size; }
+
+protected:
+	const Byte* _data;
+	std::size_t _size;
+#ifdef _WIN32
+	void*       _mapping;
+#endif
+};
+
+
+#endif
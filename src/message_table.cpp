@@ -0,0 +1,291 @@
+/*
+ *  Copyright (C) 2016 the authors (see AUTHORS)
+ *
+ *  This file is part of ld36.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include <cstring>
+#include <fstream>
+
+#include <lair/core/log.h>
+
+#include "message_table.h"
+
+
+#define CATALOG_VERSION 2
+#define EMPTY_SLOT      0xffffffffu
+
+
+MessageTable::MessageTable()
+	: _data(nullptr)
+	, _size(0)
+	, _header(nullptr)
+	, _slots(nullptr)
+	, _lines(nullptr)
+	, _blob(nullptr)
+	, _blobSize(0)
+{
+}
+
+
+void MessageTable::load(const Json::Value& json, const std::string& source) {
+	clear();
+
+	if(!json.isObject()) {
+		dbgLogger.error("MessageTable: expected an object.");
+		return;
+	}
+
+	// Keep the table at most half full.
+	uint32 nSlots = 1;
+	while(nSlots < 2 * json.size())
+		nSlots *= 2;
+
+	Slot emptySlot = { 0, EMPTY_SLOT, 0, 0 };
+	std::vector<Slot>   slots(nSlots, emptySlot);
+	std::vector<uint32> lines;
+	std::string         blob;
+
+	for(auto it = json.begin(); it != json.end(); ++it) {
+		std::string key = it.key().asString();
+		if(!it->isArray()) {
+			dbgLogger.warning("MessageTable: \"", key, "\" is not an array.");
+			continue;
+		}
+
+		uint32 h = hash(key.c_str());
+		uint32 i = h & (nSlots - 1);
+		while(slots[i].key != EMPTY_SLOT)
+			i = (i + 1) & (nSlots - 1);
+
+		Slot& slot = slots[i];
+		slot.hash      = h;
+		slot.key       = blob.size();
+		slot.firstLine = lines.size();
+		slot.nLines    = it->size();
+		blob.append(key.c_str(), key.size() + 1);
+
+		for(const Json::Value& line: *it) {
+			std::string str = line.asString();
+			lines.push_back(blob.size());
+			blob.append(str.c_str(), str.size() + 1);
+		}
+	}
+
+	Header header;
+	std::memcpy(header.magic, "LDMC", 4);
+	header.version    = CATALOG_VERSION;
+	header.sourceSize = source.size();
+	header.sourceHash = hash(source.data(), source.size());
+	header.nSlots     = nSlots;
+	header.nLines     = lines.size();
+
+	std::size_t slotsSize = slots.size() * sizeof(Slot);
+	std::size_t linesSize = lines.size() * sizeof(uint32);
+	_buffer.resize(sizeof(Header) + slotsSize + linesSize + blob.size());
+	Byte* out = _buffer.data();
+	std::memcpy(out, &header, sizeof(Header));
+	out += sizeof(Header);
+	std::memcpy(out, slots.data(), slotsSize);
+	out += slotsSize;
+	std::memcpy(out, lines.data(), linesSize);
+	out += linesSize;
+	std::memcpy(out, blob.data(), blob.size());
+
+	setImage(_buffer.data(), _buffer.size());
+}
+
+
+bool MessageTable::loadCatalog(const Path& path) {
+	clear();
+
+	if(!_file.open(path))
+		return false;
+	if(!setImage(_file.data(), _file.size())) {
+		dbgLogger.warning("MessageTable: invalid catalog \"", path, "\".");
+		clear();
+		return false;
+	}
+	return true;
+}
+
+
+bool MessageTable::writeCatalog(const Path& path) const {
+	if(!_data)
+		return false;
+
+	std::ofstream out(path.utf8CStr(), std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char*>(_data), _size);
+	return bool(out);
+}
+
+
+void MessageTable::clear() {
+	_data     = nullptr;
+	_size     = 0;
+	_header   = nullptr;
+	_slots    = nullptr;
+	_lines    = nullptr;
+	_blob     = nullptr;
+	_blobSize = 0;
+
+	_buffer.clear();
+	_buffer.shrink_to_fit();
+	_file.close();
+}
+
+
+bool MessageTable::matchesSource(const std::string& source) const {
+	return _header
+	    && _header->sourceSize == source.size()
+	    && _header->sourceHash == hash(source.data(), source.size());
+}
+
+
+MessageId MessageTable::find(const std::string& key) const {
+	if(!_header)
+		return NO_MESSAGE;
+
+	uint32 mask = _header->nSlots - 1;
+	uint32 h    = hash(key.c_str());
+	for(uint32 n = 0, i = h & mask; n < _header->nSlots; ++n, i = (i + 1) & mask) {
+		const Slot& slot = _slots[i];
+		if(slot.key == EMPTY_SLOT)
+			break;
+		if(slot.hash == h && slot.key < _blobSize
+		&& std::strcmp(_blob + slot.key, key.c_str()) == 0)
+			return i;
+	}
+
+	return NO_MESSAGE;
+}
+
+
+unsigned MessageTable::nLines(MessageId message) const {
+	const Slot* s = slot(message);
+	return s? s->nLines: 0;
+}
+
+
+const char* MessageTable::line(MessageId message, unsigned index) const {
+	const Slot* s = slot(message);
+	if(!s || index >= s->nLines || s->firstLine + index >= _header->nLines)
+		return "";
+
+	uint32 offset = _lines[s->firstLine + index];
+	return (offset < _blobSize)? _blob + offset: "";
+}
+
+
+bool MessageTable::setImage(const Byte* data, std::size_t size) {
+	if(size < sizeof(Header))
+		return false;
+
+	const Header* header = reinterpret_cast<const Header*>(data);
+	if(std::memcmp(header->magic, "LDMC", 4) != 0
+	|| header->version != CATALOG_VERSION
+	|| header->nSlots == 0
+	|| (header->nSlots & (header->nSlots - 1)) != 0)
+		return false;
+
+	std::size_t blobStart = sizeof(Header)
+	                      + std::size_t(header->nSlots) * sizeof(Slot)
+	                      + std::size_t(header->nLines) * sizeof(uint32);
+	// Strings must be NUL-terminated, so the blob must end with one.
+	if(blobStart >= size || data[size - 1] != 0)
+		return false;
+
+	_data     = data;
+	_size     = size;
+	_header   = header;
+	_slots    = reinterpret_cast<const Slot*>(data + sizeof(Header));
+	_lines    = reinterpret_cast<const uint32*>(_slots + header->nSlots);
+	_blob     = reinterpret_cast<const char*>(data + blobStart);
+	_blobSize = size - blobStart;
+
+	return true;
+}
+
+
+const MessageTable::Slot* MessageTable::slot(MessageId message) const {
+	if(!_header || message < 0 || uint32(message) >= _header->nSlots
+	|| _slots[message].key == EMPTY_SLOT)
+		return nullptr;
+	return &_slots[message];
+}
+
+
+// FNV-1a
+uint32 MessageTable::hash(const char* str) {
+	uint32 h = 2166136261u;
+	for(; *str; ++str) {
+		h ^= static_cast<unsigned char>(*str);
+		h *= 16777619u;
+	}
+	return h;
+}
+
+
+uint32 MessageTable::hash(const char* data, std::size_t size) {
+	uint32 h = 2166136261u;
+	for(std::size_t i = 0; i < size; ++i) {
+		h ^= static_cast<unsigned char>(data[i]);
+		h *= 16777619u;
+	}
+	return h;
+}
+
+
+MessageQueue::MessageQueue()
+	: _first(0)
+	, _size(0)
+{
+}
+
+
+bool MessageQueue::push(MessageId message) {
+	if(full())
+		return false;
+
+	Entry& entry = _queue[(_first + _size) % CAPACITY];
+	entry.message = message;
+	entry.line    = 0;
+	++_size;
+	return true;
+}
+
+
+bool MessageQueue::next(const MessageTable& table) {
+	if(empty())
+		return false;
+
+	Entry& entry = _queue[_first];
+	++entry.line;
+	if(entry.line >= table.nLines(entry.message)) {
+		_first = (_first + 1) % CAPACITY;
+		--_size;
+	}
+	return !empty();
+}
+
+
+void MessageQueue::clear() {
+	_first = 0;
+	_size  = 0;
+}
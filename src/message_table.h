@@ -0,0 +1,152 @@
+/*
+ *  Copyright (C) 2016 the authors (see AUTHORS)
+ *
+ *  This file is part of ld36.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#ifndef LD36_MESSAGE_TABLE_H
+#define LD36_MESSAGE_TABLE_H
+
+
+#include <string>
+#include <vector>
+
+#include <lair/core/lair.h>
+#include <lair/core/json.h>
+
+#include "mapped_file.h"
+
+
+using namespace lair;
+
+
+typedef int MessageId;
+#define NO_MESSAGE (-1)
+
+
+// Message catalog. A message is a list of lines, shown one after the other
+// in the dialog box.
+//
+// The catalog is a single binary image: a header, an open addressing hash
+// table of keys, the line offsets and a blob of NUL-terminated UTF-8
+// strings. It is either memory-mapped from a compiled file, so that only the
+// pages actually read are loaded, or built in memory from json. Catalogs are
+// compiled at build time by compile_messages.
+class MessageTable {
+public:
+	MessageTable();
+	MessageTable(const MessageTable&)  = delete;
+	MessageTable(      MessageTable&&) = delete;
+	~MessageTable() = default;
+
+	MessageTable& operator=(const MessageTable&)  = delete;
+	MessageTable& operator=(      MessageTable&&) = delete;
+
+	// json is an object of arrays of strings, parsed from source (the
+	// content of the json file), see matchesSource().
+	void load(const Json::Value& json, const std::string& source = std::string());
+	// Maps a compiled catalog. Returns false if it is missing or invalid.
+	bool loadCatalog(const Path& path);
+	bool writeCatalog(const Path& path) const;
+	void clear();
+
+	// Whether the catalog has been compiled from source, compared by size and
+	// hash of the content.
+	bool matchesSource(const std::string& source) const;
+
+	MessageId find(const std::string& key) const;
+
+	unsigned nLines(MessageId message) const;
+	const char* line(MessageId message, unsigned index) const;
+
+	// Size of the catalog image, in bytes.
+	std::size_t size() const { return _size; }
+
+protected:
+	struct Header {
+		char   magic[4];
+		uint32 version;
+		uint32 sourceSize;
+		uint32 sourceHash;
+		uint32 nSlots;
+		uint32 nLines;
+	};
+
+	struct Slot {
+		uint32 hash;
+		uint32 key;
+		uint32 firstLine;
+		uint32 nLines;
+	};
+
+	bool setImage(const Byte* data, std::size_t size);
+	const Slot* slot(MessageId message) const;
+
+	static uint32 hash(const char* str);
+	static uint32 hash(const char* data, std::size_t size);
+
+protected:
+	const Byte*       _data;
+	std::size_t       _size;
+	const Header*     _header;
+	const Slot*       _slots;
+	const uint32*     _lines;
+	const char*       _blob;
+	std::size_t       _blobSize;
+
+	// Backing storage, depending on how the catalog was loaded.
+	std::vector<Byte> _buffer;
+	MappedFile        _file;
+};
+
+
+// Fixed capacity ring buffer of (message, line) pairs waiting to be shown.
+class MessageQueue {
+public:
+	MessageQueue();
+
+	bool empty() const { return _size == 0; }
+	bool full()  const { return _size == CAPACITY; }
+
+	// Returns false if the queue is full.
+	bool push(MessageId message);
+	// Show the next line of the front message or pop it. Returns false if
+	// the queue is empty afterward.
+	bool next(const MessageTable& table);
+	void clear();
+
+	MessageId frontMessage() const { return _queue[_first].message; }
+	unsigned  frontLine()    const { return _queue[_first].line; }
+
+protected:
+	enum { CAPACITY = 16 };
+
+	struct Entry {
+		MessageId message;
+		unsigned  line;
+	};
+
+protected:
+	Entry    _queue[CAPACITY];
+	unsigned _first;
+	unsigned _size;
+};
+
+
+#endif
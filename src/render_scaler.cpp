@@ -0,0 +1,246 @@
+/*
+ *  Copyright (C) 2016 the authors (see AUTHORS)
+ *
+ *  This file is part of ld36.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <lair/core/log.h>
+
+#include "render_scaler.h"
+
+
+#define SCALE_STEP          0.1f
+#define SLOW_FRAME_COUNT    10
+#define FAST_FRAME_COUNT    120
+
+
+RenderScaler::RenderScaler(Renderer* renderer)
+	: _renderer(renderer)
+	, _support(SUPPORT_UNKNOWN)
+	, _enabled(false)
+	, _minScale(.5)
+	, _maxScale(1)
+	, _scale(1)
+	, _slowFrames(0)
+	, _fastFrames(0)
+	, _framebuffer(0)
+	, _renderbuffers{ 0, 0 }
+	, _targetWidth(0)
+	, _targetHeight(0)
+	, _windowWidth(0)
+	, _windowHeight(0)
+	, _frameWidth(0)
+	, _frameHeight(0)
+{
+}
+
+
+RenderScaler::~RenderScaler() {
+	releaseTarget();
+}
+
+
+void RenderScaler::setEnabled(bool enabled) {
+	if(enabled && !isSupported()) {
+		dbgLogger.warning("RenderScaler: framebuffer blit is not supported (requires OpenGL 3.0, "
+		                  "ARB_framebuffer_object or EXT_framebuffer_blit), "
+		                  "disabling dynamic resolution.");
+		enabled = false;
+	}
+
+	_enabled = enabled;
+	if(!_enabled) {
+		_scale = _maxScale;
+		releaseTarget();
+	}
+}
+
+
+void RenderScaler::setScaleRange(float minScale, float maxScale) {
+	_minScale = minScale;
+	_maxScale = maxScale;
+	_scale    = std::min(std::max(_scale, _minScale), _maxScale);
+}
+
+
+void RenderScaler::updateScale(int64 frameTime, int64 targetTime) {
+	if(!_enabled)
+		return;
+
+	// Drop quickly when frames are late, go back up slowly.
+	if(frameTime > targetTime * 6 / 5) {
+		++_slowFrames;
+		_fastFrames = 0;
+	}
+	else if(frameTime < targetTime * 21 / 20) {
+		++_fastFrames;
+		_slowFrames = 0;
+	}
+
+	float scale = _scale;
+	if(_slowFrames >= SLOW_FRAME_COUNT) {
+		scale = std::max(_scale - SCALE_STEP, _minScale);
+		_slowFrames = 0;
+	}
+	else if(_fastFrames >= FAST_FRAME_COUNT) {
+		scale = std::min(_scale + SCALE_STEP, _maxScale);
+		_fastFrames = 0;
+	}
+
+	if(scale != _scale) {
+		dbgLogger.info("Render scale: ", scale);
+		_scale = scale;
+	}
+}
+
+
+void RenderScaler::beginFrame(int windowWidth, int windowHeight) {
+	Context* glc = _renderer->context();
+
+	_windowWidth  = windowWidth;
+	_windowHeight = windowHeight;
+	_frameWidth   = std::max(int(windowWidth  * _scale), 1);
+	_frameHeight  = std::max(int(windowHeight * _scale), 1);
+
+	if(!_enabled || _scale >= 1) {
+		glc->viewport(0, 0, _windowWidth, _windowHeight);
+		return;
+	}
+
+	// The target has the size of the window, only part of it is used.
+	if(_targetWidth != windowWidth || _targetHeight != windowHeight) {
+		resizeTarget(windowWidth, windowHeight);
+		if(!_enabled) {
+			glc->viewport(0, 0, _windowWidth, _windowHeight);
+			return;
+		}
+	}
+
+	glc->bindFramebuffer(gl::FRAMEBUFFER, _framebuffer);
+	glc->viewport(0, 0, _frameWidth, _frameHeight);
+}
+
+
+void RenderScaler::endFrame() {
+	if(!_enabled || _scale >= 1)
+		return;
+
+	Context* glc = _renderer->context();
+
+	glc->bindFramebuffer(gl::READ_FRAMEBUFFER, _framebuffer);
+	glc->bindFramebuffer(gl::DRAW_FRAMEBUFFER, 0);
+	glc->blitFramebuffer(0, 0, _frameWidth,  _frameHeight,
+	                     0, 0, _windowWidth, _windowHeight,
+	                     gl::COLOR_BUFFER_BIT, gl::NEAREST);
+
+	glc->bindFramebuffer(gl::FRAMEBUFFER, 0);
+	glc->viewport(0, 0, _windowWidth, _windowHeight);
+}
+
+
+bool RenderScaler::isSupported() {
+	if(_support == SUPPORT_UNKNOWN)
+		_support = checkSupport(_renderer->context())? SUPPORT_YES: SUPPORT_NO;
+	return _support == SUPPORT_YES;
+}
+
+
+bool RenderScaler::checkSupport(Context* glc) {
+	const char* version = reinterpret_cast<const char*>(glc->getString(gl::VERSION));
+	if(!version)
+		return false;
+
+	// OpenGL ES 3.0 and OpenGL 3.0 both have framebuffer objects and blit.
+	const char* esPrefix = "OpenGL ES ";
+	if(std::strncmp(version, esPrefix, std::strlen(esPrefix)) == 0)
+		version += std::strlen(esPrefix);
+	if(std::atoi(version) >= 3)
+		return true;
+
+	const char* extensions = reinterpret_cast<const char*>(glc->getString(gl::EXTENSIONS));
+	return hasExtension(extensions, "GL_ARB_framebuffer_object")
+	    || (hasExtension(extensions, "GL_EXT_framebuffer_object")
+	     && hasExtension(extensions, "GL_EXT_framebuffer_blit"));
+}
+
+
+bool RenderScaler::hasExtension(const char* extensions, const char* name) {
+	if(!extensions)
+		return false;
+
+	std::size_t len = std::strlen(name);
+	for(const char* ext = std::strstr(extensions, name); ext; ext = std::strstr(ext + len, name)) {
+		bool start = ext == extensions || ext[-1] == ' ';
+		bool end   = ext[len] == ' ' || ext[len] == '\0';
+		if(start && end)
+			return true;
+	}
+	return false;
+}
+
+
+void RenderScaler::resizeTarget(int width, int height) {
+	Context* glc = _renderer->context();
+
+	if(!_framebuffer) {
+		glc->genFramebuffers(1, &_framebuffer);
+		glc->genRenderbuffers(2, _renderbuffers);
+	}
+
+	glc->bindRenderbuffer(gl::RENDERBUFFER, _renderbuffers[0]);
+	glc->renderbufferStorage(gl::RENDERBUFFER, gl::RGBA8, width, height);
+	glc->bindRenderbuffer(gl::RENDERBUFFER, _renderbuffers[1]);
+	glc->renderbufferStorage(gl::RENDERBUFFER, gl::DEPTH_COMPONENT24, width, height);
+	glc->bindRenderbuffer(gl::RENDERBUFFER, 0);
+
+	glc->bindFramebuffer(gl::FRAMEBUFFER, _framebuffer);
+	glc->framebufferRenderbuffer(gl::FRAMEBUFFER, gl::COLOR_ATTACHMENT0,
+	                             gl::RENDERBUFFER, _renderbuffers[0]);
+	glc->framebufferRenderbuffer(gl::FRAMEBUFFER, gl::DEPTH_ATTACHMENT,
+	                             gl::RENDERBUFFER, _renderbuffers[1]);
+	if(glc->checkFramebufferStatus(gl::FRAMEBUFFER) != gl::FRAMEBUFFER_COMPLETE) {
+		dbgLogger.error("RenderScaler: incomplete framebuffer, disable scaling.");
+		glc->bindFramebuffer(gl::FRAMEBUFFER, 0);
+		setEnabled(false);
+		return;
+	}
+	glc->bindFramebuffer(gl::FRAMEBUFFER, 0);
+
+	_targetWidth  = width;
+	_targetHeight = height;
+}
+
+
+void RenderScaler::releaseTarget() {
+	if(!_framebuffer)
+		return;
+
+	Context* glc = _renderer->context();
+	glc->deleteFramebuffers(1, &_framebuffer);
+	glc->deleteRenderbuffers(2, _renderbuffers);
+
+	_framebuffer      = 0;
+	_renderbuffers[0] = 0;
+	_renderbuffers[1] = 0;
+	_targetWidth      = 0;
+	_targetHeight     = 0;
+}
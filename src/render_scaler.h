@@ -0,0 +1,101 @@
+/*
+ *  Copyright (C) 2016 the authors (see AUTHORS)
+ *
+ *  This file is part of ld36.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD36_RENDER_SCALER_H
+#define LD36_RENDER_SCALER_H
+
+
+#include <lair/core/lair.h>
+
+#include <lair/render_gl2/renderer.h>
+
+
+using namespace lair;
+
+
+// Renders the scene in an offscreen framebuffer smaller than the window when
+// frames take too long, then upscales it with nearest filtering. The scale
+// goes back up once frames are fast again.
+class RenderScaler {
+public:
+	RenderScaler(Renderer* renderer);
+	RenderScaler(const RenderScaler&)  = delete;
+	RenderScaler(      RenderScaler&&) = delete;
+	~RenderScaler();
+
+	RenderScaler& operator=(const RenderScaler&)  = delete;
+	RenderScaler& operator=(      RenderScaler&&) = delete;
+
+	void setEnabled(bool enabled);
+	void setScaleRange(float minScale, float maxScale);
+
+	// Feed the duration of the last frame and the target duration.
+	void updateScale(int64 frameTime, int64 targetTime);
+
+	// Call around the scene rendering.
+	void beginFrame(int windowWidth, int windowHeight);
+	void endFrame();
+
+	float scale() const { return _scale; }
+
+	// Whether the context supports framebuffer blit, which is required.
+	// setEnabled(true) does nothing if it does not.
+	bool isSupported();
+
+protected:
+	enum Support {
+		SUPPORT_UNKNOWN,
+		SUPPORT_YES,
+		SUPPORT_NO,
+	};
+
+	static bool checkSupport(Context* glc);
+	static bool hasExtension(const char* extensions, const char* name);
+
+	void resizeTarget(int width, int height);
+	void releaseTarget();
+
+protected:
+	Renderer* _renderer;
+	Support   _support;
+
+	bool      _enabled;
+	float     _minScale;
+	float     _maxScale;
+	float     _scale;
+
+	// Number of consecutive slow and fast frames.
+	int       _slowFrames;
+	int       _fastFrames;
+
+	GLuint    _framebuffer;
+	GLuint    _renderbuffers[2];
+	int       _targetWidth;
+	int       _targetHeight;
+
+	int       _windowWidth;
+	int       _windowHeight;
+	int       _frameWidth;
+	int       _frameHeight;
+};
+
+
+#endif
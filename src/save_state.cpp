@@ -0,0 +1,95 @@
+/*
+ *  Copyright (C) 2016 the authors (see AUTHORS)
+ *
+ *  This file is part of ld36.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include "save_state.h"
+
+
+StateWriter::StateWriter(SaveState& data)
+	: _data(data)
+{
+}
+
+
+void StateWriter::write(const void* data, std::size_t size) {
+	const Byte* bytes = static_cast<const Byte*>(data);
+	_data.insert(_data.end(), bytes, bytes + size);
+}
+
+
+void StateWriter::writeString(const std::string& str) {
+	write(uint32(str.size()));
+	write(str.data(), str.size());
+}
+
+
+std::size_t StateWriter::beginBlock() {
+	std::size_t block = _data.size();
+	write(uint32(0));
+	return block;
+}
+
+
+void StateWriter::endBlock(std::size_t block) {
+	uint32 size = _data.size() - block - sizeof(uint32);
+	std::memcpy(_data.data() + block, &size, sizeof(uint32));
+}
+
+
+StateReader::StateReader(const SaveState& data)
+	: _data(data)
+	, _pos(0)
+	, _ok(true)
+{
+}
+
+
+bool StateReader::read(void* data, std::size_t size) {
+	if(!_ok || size > _data.size() - _pos) {
+		_ok = false;
+		return false;
+	}
+	std::memcpy(data, _data.data() + _pos, size);
+	_pos += size;
+	return true;
+}
+
+
+bool StateReader::readString(std::string& str) {
+	uint32 size = 0;
+	if(!read(size) || size > _data.size() - _pos) {
+		_ok = false;
+		return false;
+	}
+	str.assign(reinterpret_cast<const char*>(_data.data() + _pos), size);
+	_pos += size;
+	return true;
+}
+
+
+bool StateReader::skip(std::size_t size) {
+	if(!_ok || size > _data.size() - _pos) {
+		_ok = false;
+		return false;
+	}
+	_pos += size;
+	return true;
+}
@@ -0,0 +1,94 @@
+/*
+ *  Copyright (C) 2016 the authors (see AUTHORS)
+ *
+ *  This file is part of ld36.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#ifndef LD36_SAVE_STATE_H
+#define LD36_SAVE_STATE_H
+
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <lair/core/lair.h>
+
+
+using namespace lair;
+
+
+// Binary snapshot of the game, see MainState::saveState().
+typedef std::vector<Byte> SaveState;
+
+// Written after the "LDSS" magic. Bump it when the layout changes.
+static const uint32 SAVE_STATE_VERSION = 1;
+
+
+// Appends plain values to a SaveState. Values are written in native byte
+// order: snapshots are not meant to be exchanged between machines.
+class StateWriter {
+public:
+	StateWriter(SaveState& data);
+
+	void write(const void* data, std::size_t size);
+	void writeString(const std::string& str);
+
+	template<typename T>
+	void write(const T& value) {
+		write(&value, sizeof(T));
+	}
+
+	// Reserve room for a size, written later by endBlock(). Blocks can be
+	// skipped by readers that do not know what they contain.
+	std::size_t beginBlock();
+	void endBlock(std::size_t block);
+
+protected:
+	SaveState& _data;
+};
+
+
+// Reads values written by StateWriter. Once a read fails, all the following
+// ones fail too and ok() returns false.
+class StateReader {
+public:
+	StateReader(const SaveState& data);
+
+	bool read(void* data, std::size_t size);
+	bool readString(std::string& str);
+	bool skip(std::size_t size);
+
+	template<typename T>
+	bool read(T& value) {
+		return read(&value, sizeof(T));
+	}
+
+	bool ok()    const { return _ok; }
+	bool atEnd() const { return _pos == _data.size(); }
+
+protected:
+	const SaveState& _data;
+	std::size_t      _pos;
+	bool             _ok;
+};
+
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ *  Copyright (C) 2016 the authors (see AUTHORS)
+ *
+ *  This file is part of ld36.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include <chrono>
+
+#include <lair/core/log.h>
+
+#include "sound_player.h"
+
+
+SoundPlayer::SoundPlayer(AudioModule* audio)
+	: _audio(audio)
+	, _sounds(nullptr)
+	, _voiceCount(0)
+	, _head(0)
+	, _tail(0)
+	, _running(false)
+	, _waiting(false)
+{
+}
+
+
+SoundPlayer::~SoundPlayer() {
+	stop();
+}
+
+
+void SoundPlayer::start(const SoundList* sounds, unsigned voiceCount) {
+	lairAssert(!_running);
+
+	_sounds     = sounds;
+	_voiceCount = voiceCount;
+
+	_running = true;
+	_thread  = std::thread(&SoundPlayer::run, this);
+}
+
+
+void SoundPlayer::stop() {
+	if(!_running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_running = false;
+	}
+	_wakeUp.notify_one();
+	_thread.join();
+
+	dbgLogger.info("SoundPlayer: ", _voices.nStolen(), " voices stolen.");
+}
+
+
+bool SoundPlayer::play(SoundId sound, Uint8 distance) {
+	Request request;
+	request.type     = PLAY_SOUND;
+	request.sound    = sound;
+	request.distance = distance;
+	return push(request);
+}
+
+
+bool SoundPlayer::playMusic(AssetSP music, float volume) {
+	Request request;
+	request.type   = PLAY_MUSIC;
+	request.volume = volume;
+	request.music  = music;
+	return push(request);
+}
+
+
+bool SoundPlayer::setVolume(float volume) {
+	Request request;
+	request.type   = SET_VOLUME;
+	request.volume = volume;
+	return push(request);
+}
+
+
+bool SoundPlayer::push(Request& request) {
+	unsigned head = _head.load(std::memory_order_relaxed);
+	if(head - _tail.load(std::memory_order_acquire) == QUEUE_SIZE)
+		return false;
+
+	_queue[head % QUEUE_SIZE] = std::move(request);
+	_head.store(head + 1);
+
+	// The mutex is only taken when the audio thread sleeps. It is never held
+	// while the audio device is locked.
+	if(_waiting) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_wakeUp.notify_one();
+	}
+	return true;
+}
+
+
+bool SoundPlayer::pop(Request& request) {
+	unsigned tail = _tail.load(std::memory_order_relaxed);
+	if(tail == _head.load(std::memory_order_acquire))
+		return false;
+
+	request = std::move(_queue[tail % QUEUE_SIZE]);
+	_tail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+
+void SoundPlayer::process(Request& request) {
+	switch(request.type) {
+	case PLAY_SOUND: {
+		const SoundInfo& info = (*_sounds)[request.sound];
+		int voice = _voices.allocate(request.sound, info.priority, info.maxInstances);
+		if(voice < 0)
+			break;
+
+		Mix_SetDistance(voice, request.distance);
+		_audio->playSound(info.asset, 0, voice);
+		break;
+	}
+	case PLAY_MUSIC:
+		_audio->setMusicVolume(request.volume);
+		_audio->playMusic(request.music);
+		request.music.reset();
+		break;
+	case SET_VOLUME:
+		Mix_Volume(-1, int(request.volume * MIX_MAX_VOLUME));
+		break;
+	}
+}
+
+
+void SoundPlayer::run() {
+	_voices.setVoiceCount(_voiceCount);
+
+	Request request;
+	while(_running) {
+		while(pop(request))
+			process(request);
+
+		// Sleep until play() or stop() wakes us up. _waiting is set before
+		// checking the queue again, so either the request pushed in between
+		// is seen here or play() sees _waiting and notifies. The timeout is
+		// only a safety net.
+		std::unique_lock<std::mutex> lock(_mutex);
+		_waiting = true;
+		if(_running && _head.load() == _tail.load(std::memory_order_relaxed))
+			_wakeUp.wait_for(lock, std::chrono::seconds(1));
+		_waiting = false;
+	}
+}
@@ -0,0 +1,128 @@
+/*
+ *  Copyright (C) 2016 the authors (see AUTHORS)
+ *
+ *  This file is part of ld36.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#ifndef LD36_SOUND_PLAYER_H
+#define LD36_SOUND_PLAYER_H
+
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <lair/core/lair.h>
+
+#include <lair/sys_sdl2/audio_module.h>
+
+#include "voice_pool.h"
+
+
+using namespace lair;
+
+
+// Index in the SoundList, resolved once when the sound is preloaded.
+typedef int SoundId;
+#define NO_SOUND (-1)
+
+struct SoundInfo {
+	AssetSP  asset;
+	float    volume;
+	int      priority;
+	unsigned maxInstances;
+	// Whether the sound is attenuated with the distance to the player.
+	bool     positional;
+};
+
+typedef std::vector<SoundInfo> SoundList;
+
+
+// Plays sounds and music from a dedicated thread, so that the game thread
+// never waits on the audio device lock. Requests go through a fixed size
+// single-producer single-consumer queue: play(), playMusic() and setVolume()
+// must only be called from one thread. While the player runs, it is the only
+// one to call SDL_mixer.
+class SoundPlayer {
+public:
+	SoundPlayer(AudioModule* audio);
+	SoundPlayer(const SoundPlayer&)  = delete;
+	SoundPlayer(      SoundPlayer&&) = delete;
+	~SoundPlayer();
+
+	SoundPlayer& operator=(const SoundPlayer&)  = delete;
+	SoundPlayer& operator=(      SoundPlayer&&) = delete;
+
+	// sounds must not change while the player is running.
+	void start(const SoundList* sounds, unsigned voiceCount);
+	void stop();
+
+	// These return false if the queue is full, in which case the request is
+	// dropped.
+	bool play(SoundId sound, Uint8 distance = 0);
+	bool playMusic(AssetSP music, float volume);
+	// Volume of all the sound channels, between 0 and 1.
+	bool setVolume(float volume);
+
+protected:
+	enum { QUEUE_SIZE = 64 };
+
+	enum RequestType {
+		PLAY_SOUND,
+		PLAY_MUSIC,
+		SET_VOLUME,
+	};
+
+	struct Request {
+		RequestType type;
+		SoundId     sound;
+		Uint8       distance;
+		float       volume;
+		AssetSP     music;
+	};
+
+	bool push(Request& request);
+	bool pop(Request& request);
+	void process(Request& request);
+	void run();
+
+protected:
+	AudioModule*          _audio;
+	const SoundList*      _sounds;
+	unsigned              _voiceCount;
+	VoicePool             _voices;
+
+	Request               _queue[QUEUE_SIZE];
+	// Written by the game thread only.
+	std::atomic<unsigned> _head;
+	// Written by the audio thread only.
+	std::atomic<unsigned> _tail;
+
+	std::thread             _thread;
+	std::atomic<bool>       _running;
+	// Set while the audio thread is about to sleep or sleeping.
+	std::atomic<bool>       _waiting;
+	std::mutex              _mutex;
+	std::condition_variable _wakeUp;
+};
+
+
+#endif
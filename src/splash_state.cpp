@@ -50,6 +50,9 @@ SplashState::SplashState(Game* game)
       _loop(sys()),
       _fpsTime(0),
       _fpsCount(0),
+      _skipCount(0),
+      _lastChangeTime(0),
+      _lastRenderTime(0),
 
       _skipInput(nullptr),
 
@@ -67,8 +70,8 @@ SplashState::~SplashState() {
 
 void SplashState::initialize() {
 	_loop.reset();
-	_loop.setTickDuration(    ONE_SEC /  60);
-	_loop.setFrameDuration(   ONE_SEC /  60);
+	_loop.setTickDuration(    ONE_SEC / game()->tickRate());
+	_loop.setFrameDuration(   ONE_SEC / game()->frameRate());
 	_loop.setMaxFrameDuration(_loop.frameDuration() * 3);
 	_loop.setFrameMargin(     _loop.frameDuration() / 2);
 
@@ -112,6 +115,8 @@ void SplashState::run() {
 	_loop.start();
 	_fpsTime  = sys()->getTimeNs();
 	_fpsCount = 0;
+	_skipCount = 0;
+	_lastChangeTime = _fpsTime;
 
 	do {
 		switch(_loop.nextEvent()) {
@@ -144,6 +149,7 @@ void SplashState::setup(GameState* nextState, const Path& splashImage, float ski
 	_nextState = nextState;
 	_sprites.get(_splash)->setTexture(splashImage);
 	loader()->waitAll();
+	_lastChangeTime = sys()->getTimeNs();
 }
 
 
@@ -152,10 +158,15 @@ void SplashState::updateTick() {
 
 	_skipTime -= float(_loop.tickDuration()) / float(ONE_SEC);
 
-	if (_skipTime <= 0
+	// Finish loading the next state once the splash has been shown at least
+	// once. Skipping is only possible after that.
+	if(!game()->isLoaded() && _lastRenderTime)
+		game()->finishLoading();
+
+	if (game()->isLoaded() && (_skipTime <= 0
 	|| _skipInput->justPressed()
 //	|| sys()->getKeyState(SDL_SCANCODE_SPACE)
-	|| sys()->getKeyState(SDL_SCANCODE_RETURN)) {
+	|| sys()->getKeyState(SDL_SCANCODE_RETURN))) {
 		// ESC quite the game.
 		if(sys()->getKeyState(SDL_SCANCODE_ESCAPE))
 			_nextState = nullptr;
@@ -169,6 +180,31 @@ void SplashState::updateTick() {
 void SplashState::updateFrame() {
 	renderer()->uploadPendingTextures();
 
+	// The splash screen is static: only render when it changed, and from
+	// time to time just in case.
+	uint64 now = sys()->getTimeNs();
+	bool idle = now - _lastChangeTime > 2 * uint64(_loop.tickDuration())
+	         && now - _lastRenderTime < ONE_SEC / IDLE_FRAMERATE;
+	++_fpsCount;
+	if(idle) {
+		++_skipCount;
+	}
+	else {
+		renderFrame();
+		_lastRenderTime = now;
+	}
+
+	if(_fpsCount == game()->frameRate()) {
+		log().info("Fps: ", _fpsCount * float(ONE_SEC) / (now - _fpsTime),
+		           " (skipped: ", _skipCount, ")");
+		_fpsTime   = now;
+		_fpsCount  = 0;
+		_skipCount = 0;
+	}
+}
+
+
+void SplashState::renderFrame() {
 	// Rendering
 	Context* glc = renderer()->context();
 
@@ -184,14 +220,6 @@ void SplashState::updateFrame() {
 
 	window()->swapBuffers();
 	glc->setLogCalls(false);
-
-	uint64 now = sys()->getTimeNs();
-	++_fpsCount;
-	if(_fpsCount == 60) {
-		log().info("Fps: ", _fpsCount * float(ONE_SEC) / (now - _fpsTime));
-		_fpsTime  = now;
-		_fpsCount = 0;
-	}
 }
 
 
@@ -202,6 +230,7 @@ void SplashState::resizeEvent() {
 	                     1));
 	_camera.setViewBox(viewBox);
 	renderer()->context()->viewport(0, 0, window()->width(), window()->height());
+	_lastChangeTime = sys()->getTimeNs();
 }
 
 
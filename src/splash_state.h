@@ -60,6 +60,7 @@ public:
 	void setup(GameState* nextState, const Path& splashImage, float skipTime = 1.e20);
 	void updateTick();
 	void updateFrame();
+	void renderFrame();
 
 	void resizeEvent();
 
@@ -85,6 +86,9 @@ protected:
 	InterpLoop  _loop;
 	int64       _fpsTime;
 	unsigned    _fpsCount;
+	unsigned    _skipCount;
+	uint64      _lastChangeTime;
+	uint64      _lastRenderTime;
 
 	Input*      _skipInput;
 
@@ -0,0 +1,94 @@
+/*
+ *  Copyright (C) 2016 the authors (see AUTHORS)
+ *
+ *  This file is part of ld36.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#include <lair/core/log.h>
+
+#include "voice_pool.h"
+
+
+VoicePool::VoicePool()
+	: _clock(0)
+	, _nStolen(0)
+{
+}
+
+
+void VoicePool::setVoiceCount(unsigned count) {
+	int allocated = Mix_AllocateChannels(count);
+	if(allocated != int(count))
+		dbgLogger.warning("VoicePool: got ", allocated, " voices instead of ", count, ".");
+
+	Voice voice;
+	voice.sound    = -1;
+	voice.priority = 0;
+	voice.start    = 0;
+	_voices.assign(allocated, voice);
+}
+
+
+int VoicePool::allocate(int sound, int priority, unsigned maxInstances) {
+	int      free       = -1;
+	int      victim     = -1;
+	int      oldestSame = -1;
+	unsigned nSame      = 0;
+
+	for(int i = 0; i < int(_voices.size()); ++i) {
+		const Voice& v = _voices[i];
+		if(!Mix_Playing(i)) {
+			if(free < 0)
+				free = i;
+			continue;
+		}
+
+		if(v.sound == sound) {
+			++nSame;
+			if(oldestSame < 0 || v.start < _voices[oldestSame].start)
+				oldestSame = i;
+		}
+
+		if(v.priority <= priority
+		&& (victim < 0
+		 || v.priority <  _voices[victim].priority
+		 || (v.priority == _voices[victim].priority && v.start < _voices[victim].start)))
+			victim = i;
+	}
+
+	int voice = victim;
+	if(maxInstances && nSame >= maxInstances)
+		voice = oldestSame;
+	else if(free >= 0)
+		voice = free;
+
+	if(voice < 0)
+		return -1;
+
+	// Playing on a busy channel halts what was playing there.
+	if(voice != free)
+		++_nStolen;
+
+	Voice& v = _voices[voice];
+	v.sound    = sound;
+	v.priority = priority;
+	v.start    = ++_clock;
+
+	return voice;
+}
@@ -0,0 +1,74 @@
+/*
+ *  Copyright (C) 2016 the authors (see AUTHORS)
+ *
+ *  This file is part of ld36.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+
+#ifndef LD36_VOICE_POOL_H
+#define LD36_VOICE_POOL_H
+
+
+#include <vector>
+
+#include <lair/core/lair.h>
+
+#include <lair/sys_sdl2/audio_module.h>
+
+
+using namespace lair;
+
+
+// Assigns SDL_mixer channels (voices) to sounds. When all voices are busy,
+// the oldest voice with the lowest priority not above the new sound is
+// stolen. Sounds may also limit their number of simultaneous instances, in
+// which case their own oldest instance is replaced.
+class VoicePool {
+public:
+	VoicePool();
+	VoicePool(const VoicePool&)  = delete;
+	VoicePool(      VoicePool&&) = delete;
+	~VoicePool() = default;
+
+	VoicePool& operator=(const VoicePool&)  = delete;
+	VoicePool& operator=(      VoicePool&&) = delete;
+
+	void setVoiceCount(unsigned count);
+	unsigned voiceCount() const { return _voices.size(); }
+
+	// Returns the voice on which to play sound, or -1 if every voice is busy
+	// with a more important sound. maxInstances == 0 means no limit.
+	int allocate(int sound, int priority, unsigned maxInstances);
+
+	unsigned nStolen() const { return _nStolen; }
+
+protected:
+	struct Voice {
+		int    sound;
+		int    priority;
+		uint64 start;
+	};
+
+protected:
+	std::vector<Voice> _voices;
+	uint64             _clock;
+	unsigned           _nStolen;
+};
+
+
+#endif